@@ -30,4 +30,9 @@ void mmu_set_ptr1( uint32_t* x );
 // configure MMU: set 2-bit permission field of domain d to x
 void mmu_set_dom( int d, uint8_t x );
 
+// query MMU: get the virtual address that caused the last data abort
+uint32_t mmu_get_dfar();
+// query MMU: get the status         of      the last data abort
+uint32_t mmu_get_dfsr();
+
 #endif
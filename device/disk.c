@@ -119,3 +119,65 @@ int disk_rd( uint32_t a,       uint8_t* x) {
 
   return DISK_FAILURE;
 }
+
+int disk_wr_many( uint32_t a, const uint8_t* x, int n ) {
+  int r = DISK_SUCCESS;
+
+  // issue every request before waiting for any acknowledgement
+  for( int i = 0; i < n; i++ ) {
+      PL011_puth( UART2, 0x01, true );        // write command
+      PL011_putc( UART2, ' ',  true );        // write separator
+       addr_puth( UART2, a + i, true );       // write address
+      PL011_putc( UART2, ' ',  true );        // write separator
+       data_puth( UART2, x + 64 * i, 64, true ); // write data
+      PL011_putc( UART2, '\n', true );        // write EOL
+  }
+
+  // collect the acknowledgements in order, retrying any failed block on its own
+  for( int i = 0; i < n; i++ ) {
+    bool okay = PL011_geth( UART2, true ) == 0x00; // read  command
+                PL011_getc( UART2,       true );   // read  EOL
+
+    if( !okay && disk_wr( a + i, x + 64 * i ) < 0 ) {
+      r = DISK_FAILURE;
+    }
+  }
+
+  return r;
+}
+
+int disk_rd_many( uint32_t a,       uint8_t* x, int n ) {
+  int r = DISK_SUCCESS;
+
+  // issue every request before waiting for any response
+  for( int i = 0; i < n; i++ ) {
+      PL011_puth( UART2, 0x02, true );        // write command
+      PL011_putc( UART2, ' ',  true );        // write separator
+       addr_puth( UART2, a + i, true );       // write address
+      PL011_putc( UART2, '\n', true );        // write EOL
+  }
+
+  // collect the responses in order, remembering which blocks need to be retried
+  uint8_t failed[ n ];
+
+  for( int i = 0; i < n; i++ ) {
+    if( PL011_geth( UART2, true ) == 0x00 ) { // read  command
+      PL011_getc( UART2,       true );        // read  separator
+       data_geth( UART2, x + 64 * i, 64, true ); // read  data
+      PL011_getc( UART2,       true );        // read  EOL
+      failed[ i ] = false;
+    }
+    else {
+      PL011_getc( UART2,       true );        // read  EOL
+      failed[ i ] = true;
+    }
+  }
+
+  for( int i = 0; i < n; i++ ) {
+    if( failed[ i ] && disk_rd( a + i, x + 64 * i ) < 0 ) {
+      r = DISK_FAILURE;
+    }
+  }
+
+  return r;
+}
@@ -40,4 +40,15 @@ extern int disk_wr( uint32_t a, const uint8_t* x);
 // read  an n-byte block of data x from the disk at block address a
 extern int disk_rd( uint32_t a,       uint8_t* x);
 
+/* The _many variants transfer n consecutive blocks starting at
+ * block address a, sending every request before waiting for the
+ * first response so the per-block round trip over the UART is
+ * only paid once; any block that fails is retried on its own.
+ */
+
+// write n 64-byte blocks of data x to   the disk at block addresses a...a+n-1
+extern int disk_wr_many( uint32_t a, const uint8_t* x, int n );
+// read  n 64-byte blocks of data x from the disk at block addresses a...a+n-1
+extern int disk_rd_many( uint32_t a,       uint8_t* x, int n );
+
 #endif
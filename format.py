@@ -1,16 +1,55 @@
+import struct, sys
+
+# Sectors per filesystem block, which must match BLOCK_SECTORS in kernel/bcache.h (e.g. --block-sectors=8 for 512 byte blocks)
+BLOCK_SECTORS = 8
+for arg in sys.argv[1:]:
+    if arg.startswith("--block-sectors="):
+        BLOCK_SECTORS = int(arg.split("=")[1])
+
+# Layout, as in kernel/file.h: the bitmap, then the inode table, then the data blocks up to the swap area
+SECTOR_LENGTH = 64
+BLOCK_LENGTH = BLOCK_SECTORS * SECTOR_LENGTH
+FS_BLOCKS = 16384 // BLOCK_SECTORS
+INODES = 128
+INODE_LENGTH = 64
+INODE_BLOCKS = INODES // (BLOCK_LENGTH // INODE_LENGTH)
+BITMAP_LENGTH = (INODES + FS_BLOCKS + BLOCK_LENGTH * 8 - 1) // (BLOCK_LENGTH * 8)
+DATA_START = BITMAP_LENGTH + INODE_BLOCKS
+DIR_ENTRY_LENGTH = 64
+DIR_NAME_LENGTH = 56
+ENTRY_FREE = 0xFFFFFFFF
+DIRECTORY = 0
+
+# Directory layout, as in kernel/dir.h: a header, then the first block of the hash index, then the first bucket of entries
+DIR_INDEX_BLOCKS = BLOCK_LENGTH // 8
+DIR_NEW_BLOCKS = 3
+if BLOCK_LENGTH < 256:
+    sys.exit("Directories need blocks of at least 256 bytes (--block-sectors=4 or more)")
+
 disk = open("disk.bin", 'r+b')
 
-# Set the bitmap
+# Clear the bitmap and inode table, then mark inode 0 and data blocks 0 to 2 (bits INODES onwards) as taken
+disk.seek(0)
+disk.write(bytearray(DATA_START * BLOCK_LENGTH))
 disk.seek(0)
 disk.write(bytearray([1]))
-disk.seek(16)
-disk.write(bytearray([1]))
+disk.seek(INODES // 8)
+disk.write(bytearray([(1 << DIR_NEW_BLOCKS) - 1]))
+
+# Initialise the root directory inode (type, size, 12 direct pointers, indirect and double indirect)
+# Its blocks are data blocks 0 to 2 and the rest are unused
+disk.seek(BITMAP_LENGTH * BLOCK_LENGTH)
+disk.write(struct.pack('<II', DIRECTORY, DIR_NEW_BLOCKS * BLOCK_LENGTH) + struct.pack('<14i', *(list(range(DIR_NEW_BLOCKS)) + [-1] * (14 - DIR_NEW_BLOCKS))))
+
+# Data block 0 is the root directory's header (depth, entries, blocks, parent, name and where each index block is)
+# The root directory is its own parent and has no name, and only the first index block is in use
+disk.seek(DATA_START * BLOCK_LENGTH)
+disk.write(struct.pack('<4I', 0, 0, DIR_NEW_BLOCKS, 0) + bytearray(DIR_NAME_LENGTH) + struct.pack('<%di' % DIR_INDEX_BLOCKS, *([1] + [-1] * (DIR_INDEX_BLOCKS - 1))))
 
-# Initialise the root directory inode
-for i in range(3,13):
-    disk.seek(32*64 + i*4)
-    disk.write(bytearray([255, 255, 255, 255]))
+# Data block 1 is the first index block, with its one slot pointing at block 2 (depth 0)
+disk.seek((DATA_START + 1) * BLOCK_LENGTH)
+disk.write(struct.pack('<I', 2) + bytearray(BLOCK_LENGTH - 4))
 
-# Initialise the root directory entry
-disk.seek(160*64);
-disk.write(bytearray([0, 0, 0, 0, 0, 47]))
+# Data block 2 is the first bucket, with every entry free
+for i in range(BLOCK_LENGTH // DIR_ENTRY_LENGTH):
+    disk.write(struct.pack('<II', ENTRY_FREE, 0) + bytearray(DIR_ENTRY_LENGTH - 8))
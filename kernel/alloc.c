@@ -0,0 +1,483 @@
+#include "alloc.h"
+#include "process.h"
+#include "file.h"
+
+// Bookkeeping for every page in the pool
+page_t page_map[MAX_POOL_PAGES];
+uint32_t pool_pages = 0;
+
+// Buddy free lists, one per block order
+page_t* free_area[MAX_ORDER + 1];
+uint32_t free_blocks[MAX_ORDER + 1];
+
+// All object caches
+#define MAX_CACHES (32)
+kmem_cache_t caches[MAX_CACHES];
+int num_caches = 0;
+
+// Typed caches for kernel objects
+kmem_cache_t* pcb_cache;
+kmem_cache_t* pnode_cache;
+kmem_cache_t* plist_cache;
+kmem_cache_t* file_cache;
+
+// Power of 2 sized caches used by kmalloc (16 bytes up to 2 KiB)
+kmem_cache_t* kmalloc_caches[KMALLOC_CLASSES];
+const char* kmalloc_names[KMALLOC_CLASSES] = {
+    "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048"
+};
+
+
+/**********************************
+ * PAGE HELPERS
+**********************************/
+
+// Get the bookkeeping entry for an address in the pool
+page_t* addr_to_page(uint32_t addr) {
+    return &page_map[(addr - ((uint32_t) &pool_start)) / PAGE_SIZE];
+}
+
+// Get the address of the page described by a bookkeeping entry
+uint32_t page_to_addr(page_t* page) {
+    return ((uint32_t) &pool_start) + (page - page_map) * PAGE_SIZE;
+}
+
+// Add a page to the front of a doubly linked list
+void page_push(page_t** list, page_t* page) {
+    page->prev = NULL;
+    page->next = *list;
+    if (*list != NULL) {
+        (*list)->prev = page;
+    }
+    *list = page;
+}
+
+// Unlink a page from a doubly linked list
+void page_remove(page_t** list, page_t* page) {
+    if (page->prev != NULL) {
+        page->prev->next = page->next;
+    } else {
+        *list = page->next;
+    }
+    if (page->next != NULL) {
+        page->next->prev = page->prev;
+    }
+    page->next = NULL;
+    page->prev = NULL;
+}
+
+
+/**********************************
+ * BUDDY ALLOCATOR
+**********************************/
+
+// Put a free block onto the correct free list
+void buddy_push(page_t* page, uint32_t order) {
+    page->order = order;
+    page->flags = PAGE_FREE;
+    page_push(&free_area[order], page);
+    free_blocks[order]++;
+}
+
+// Take a free block off its free list
+void buddy_remove(page_t* page) {
+    page_remove(&free_area[page->order], page);
+    free_blocks[page->order]--;
+    page->flags = 0;
+}
+
+// Allocate 2^order contiguous pages, returns 0 if there is no block large enough
+uint32_t alloc_pages(uint32_t order) {
+    // Find the smallest free block that fits
+    uint32_t o = order;
+    while (o <= MAX_ORDER && free_area[o] == NULL) {
+        o++;
+    }
+    if (o > MAX_ORDER) {
+        return 0;
+    }
+    page_t* page = free_area[o];
+    buddy_remove(page);
+
+    // Split it in half until it is the right size, freeing the upper halves
+    while (o > order) {
+        o--;
+        buddy_push(page + (1 << o), o);
+    }
+    page->order = order;
+    return page_to_addr(page);
+}
+
+// Free 2^order contiguous pages, merging with free buddies where possible
+void free_pages(uint32_t addr, uint32_t order) {
+    uint32_t index = addr_to_page(addr) - page_map;
+    page_map[index].flags = 0;
+    while (order < MAX_ORDER) {
+        uint32_t buddy = index ^ (1 << order);
+        if (buddy + (1 << order) > pool_pages) {
+            break;
+        }
+        page_t* page = &page_map[buddy];
+        if (!(page->flags & PAGE_FREE) || page->order != order) {
+            break;
+        }
+        buddy_remove(page);
+        index = index < buddy ? index : buddy;
+        order++;
+    }
+    buddy_push(&page_map[index], order);
+}
+
+// Total number of free pages in the pool
+uint32_t free_page_count() {
+    uint32_t count = 0;
+    for (int i = 0; i <= MAX_ORDER; i++) {
+        count += free_blocks[i] << i;
+    }
+    return count;
+}
+
+
+/**********************************
+ * SLAB ALLOCATOR
+**********************************/
+
+// Add a slab to one of a cache's lists
+void slab_push(slist_t* list, page_t* slab) {
+    page_push(&list->head, slab);
+    list->len++;
+}
+
+// Remove a slab from one of a cache's lists
+void slab_remove(slist_t* list, page_t* slab) {
+    page_remove(&list->head, slab);
+    list->len--;
+}
+
+// Number of slabs owned by a cache
+uint32_t cache_slabs(kmem_cache_t* cache) {
+    return cache->partial.len + cache->full.len + cache->empty.len;
+}
+
+// Get a new slab from the buddy allocator and carve it into objects
+page_t* cache_grow(kmem_cache_t* cache) {
+    uint32_t addr = alloc_pages(cache->order);
+    if (addr == 0) {
+        return NULL;
+    }
+    page_t* slab = addr_to_page(addr);
+    for (int i = 0; i < (1 << cache->order); i++) {
+        slab[i].head = slab;
+        slab[i].cache = cache;
+        slab[i].flags = PAGE_SLAB;
+    }
+
+    // Thread the free list through the objects themselves
+    slab->free = NULL;
+    for (int i = cache->per_slab - 1; i >= 0; i--) {
+        void** obj = (void**) (addr + i * cache->size);
+        *obj = slab->free;
+        slab->free = obj;
+    }
+    slab->inuse = 0;
+    slab_push(&cache->empty, slab);
+    return slab;
+}
+
+// Create a cache of objects of a given size, keeping enough slabs for 'reserved' objects at all times
+kmem_cache_t* cache_create(const char* name, uint32_t size, uint32_t reserved) {
+    if (num_caches == MAX_CACHES) {
+        return NULL;
+    }
+    kmem_cache_t* cache = &caches[num_caches++];
+    memset(cache, 0, sizeof(kmem_cache_t));
+    cache->name = name;
+
+    // Objects must be able to hold a free list pointer and stay 8 byte aligned (per AAPCS)
+    cache->size = size < 8 ? 8 : (size + 7) & ~7;
+
+    // Use bigger slabs for big objects so that at least 4 fit in each
+    cache->order = 0;
+    while ((PAGE_SIZE << cache->order) < cache->size * 4 && cache->order < 3) {
+        cache->order++;
+    }
+    cache->per_slab = (PAGE_SIZE << cache->order) / cache->size;
+
+    // Pre-allocate the reserved objects, so they can never fail to be allocated
+    cache->reserved = (reserved + cache->per_slab - 1) / cache->per_slab;
+    for (int i = 0; i < cache->reserved; i++) {
+        cache_grow(cache);
+    }
+    return cache;
+}
+
+// Allocate an object from a cache
+void* cache_alloc(kmem_cache_t* cache) {
+    // Prefer partially used slabs, then empty ones, then a brand new one
+    page_t* slab;
+    slist_t* list;
+    if (cache->partial.head != NULL) {
+        slab = cache->partial.head;
+        list = &cache->partial;
+    } else {
+        if (cache->empty.head == NULL && cache_grow(cache) == NULL) {
+            cache->failures++;
+            return NULL;
+        }
+        slab = cache->empty.head;
+        list = &cache->empty;
+    }
+
+    // Take the first free object
+    void** obj = slab->free;
+    slab->free = *obj;
+    slab->inuse++;
+
+    // Move the slab to the correct list
+    if (slab->inuse == cache->per_slab) {
+        slab_remove(list, slab);
+        slab_push(&cache->full, slab);
+    } else if (list == &cache->empty) {
+        slab_remove(list, slab);
+        slab_push(&cache->partial, slab);
+    }
+
+    // Update counters
+    cache->allocs++;
+    cache->inuse++;
+    if (cache->inuse > cache->peak) {
+        cache->peak = cache->inuse;
+    }
+    return obj;
+}
+
+// Return an object to its cache
+void cache_free(kmem_cache_t* cache, void* obj) {
+    if (obj == NULL) {
+        return;
+    }
+    page_t* slab = addr_to_page((uint32_t) obj)->head;
+    slist_t* list = slab->inuse == cache->per_slab ? &cache->full : &cache->partial;
+
+    // Put the object back on the slab's free list
+    *((void**) obj) = slab->free;
+    slab->free = obj;
+    slab->inuse--;
+
+    // Move the slab to the correct list, giving empty slabs back unless they are reserved
+    if (slab->inuse == 0) {
+        slab_remove(list, slab);
+        if (cache_slabs(cache) >= cache->reserved) {
+            for (int i = 0; i < (1 << cache->order); i++) {
+                slab[i].flags = 0;
+                slab[i].cache = NULL;
+            }
+            free_pages(page_to_addr(slab), cache->order);
+        } else {
+            slab_push(&cache->empty, slab);
+        }
+    } else if (list == &cache->full) {
+        slab_remove(list, slab);
+        slab_push(&cache->partial, slab);
+    }
+
+    // Update counters
+    cache->frees++;
+    cache->inuse--;
+}
+
+// Bytes held by a cache's slabs that are not in use by live objects
+uint32_t cache_wasted(kmem_cache_t* cache) {
+    return cache_slabs(cache) * (PAGE_SIZE << cache->order) - cache->inuse * cache->size;
+}
+
+// Copy out the usage of up to max caches, returns how many caches there are
+int cache_stats(kmem_cache_stat_t* stats, int max) {
+    for (int i = 0; i < num_caches && i < max; i++) {
+        kmem_cache_t* cache = &caches[i];
+        stats[i] = (kmem_cache_stat_t) {
+            cache->name, cache->size, cache->inuse, cache->peak,
+            cache->allocs, cache->failures, cache_wasted(cache)
+        };
+    }
+    return num_caches;
+}
+
+
+/**********************************
+ * GENERAL PURPOSE ALLOCATION
+**********************************/
+
+// Allocate memory of any size, from the matching power of 2 cache or straight from the buddy allocator
+void* kmalloc_raw(size_t size) {
+    // Find the smallest class that fits
+    for (int i = 0; i < KMALLOC_CLASSES; i++) {
+        if (size <= (16 << i)) {
+            return cache_alloc(kmalloc_caches[i]);
+        }
+    }
+
+    // Too big for a cache, so allocate whole pages
+    uint32_t order = 0;
+    while ((PAGE_SIZE << order) < size) {
+        order++;
+    }
+    return (void*) alloc_pages(order);
+}
+
+// Free memory from kmalloc
+void kfree(void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+#ifdef KMEM_PROFILE
+    kmem_untrack(ptr);
+#endif
+    page_t* page = addr_to_page((uint32_t) ptr);
+    if (page->flags & PAGE_SLAB) {
+        cache_free(page->cache, ptr);
+    } else {
+        free_pages((uint32_t) ptr, page->order);
+    }
+}
+
+
+/**********************************
+ * CALLSITE PROFILING
+**********************************/
+
+#ifdef KMEM_PROFILE
+
+// Live allocation, a NULL ptr is an empty entry and KMEM_DELETED one that was freed
+typedef struct {
+    void* ptr;
+    uint32_t size;
+    uint32_t site;
+} kmem_live_t;
+
+#define KMEM_DELETED ((void*) 1)
+
+// Callsites seen so far, and the live allocations hashed by address
+kmem_site_t kmem_sites[MAX_KMEM_SITES];
+int num_kmem_sites = 0;
+kmem_live_t kmem_live[MAX_KMEM_LIVE];
+
+// Find the entry for a callsite, adding it if it is new (returns -1 if the table is full)
+int kmem_find_site(const char* file, uint32_t line) {
+    for (int i = 0; i < num_kmem_sites; i++) {
+        if (kmem_sites[i].file == file && kmem_sites[i].line == line) {
+            return i;
+        }
+    }
+    if (num_kmem_sites == MAX_KMEM_SITES) {
+        return -1;
+    }
+    kmem_sites[num_kmem_sites] = (kmem_site_t) {file, line, 0, 0, 0};
+    return num_kmem_sites++;
+}
+
+// Get the hash table slot to start looking for an address at
+uint32_t kmem_hash(void* ptr) {
+    return (((uint32_t) ptr) >> 3) % MAX_KMEM_LIVE;
+}
+
+// Allocate memory and charge it to the caller's file and line
+void* kmalloc_site(size_t size, const char* file, uint32_t line) {
+    void* ptr = kmalloc_raw(size);
+    int site = kmem_find_site(file, line);
+    if (ptr == NULL || site == -1) {
+        return ptr;
+    }
+
+    // Remember who owns the allocation, if there is room to
+    for (uint32_t i = 0, h = kmem_hash(ptr); i < MAX_KMEM_LIVE; i++, h = (h + 1) % MAX_KMEM_LIVE) {
+        if (kmem_live[h].ptr == NULL || kmem_live[h].ptr == KMEM_DELETED) {
+            kmem_live[h] = (kmem_live_t) {ptr, size, site};
+            kmem_site_t* s = &kmem_sites[site];
+            s->count++;
+            s->live += size;
+            if (s->live > s->peak) {
+                s->peak = s->live;
+            }
+            break;
+        }
+    }
+    return ptr;
+}
+
+// Charge a free back to the callsite that made the allocation
+void kmem_untrack(void* ptr) {
+    for (uint32_t i = 0, h = kmem_hash(ptr); i < MAX_KMEM_LIVE && kmem_live[h].ptr != NULL; i++, h = (h + 1) % MAX_KMEM_LIVE) {
+        if (kmem_live[h].ptr == ptr) {
+            kmem_sites[kmem_live[h].site].live -= kmem_live[h].size;
+            kmem_live[h].ptr = KMEM_DELETED;
+            return;
+        }
+    }
+}
+
+// Copy out the per-callsite counters, returns how many sites there are
+int kmem_site_stats(kmem_site_t* stats, int max) {
+    for (int i = 0; i < num_kmem_sites && i < max; i++) {
+        stats[i] = kmem_sites[i];
+    }
+    return num_kmem_sites;
+}
+
+#else
+
+// Callsite profiling is not built in
+int kmem_site_stats(kmem_site_t* stats, int max) {
+    return -1;
+}
+
+#endif
+
+
+/**********************************
+ * INITIALISATION
+**********************************/
+
+// Set up the buddy allocator and the kernel caches
+void alloc_init() {
+    // Work out how many pages the pool has
+    pool_pages = (((uint32_t) &pool_end) - ((uint32_t) &pool_start)) / PAGE_SIZE;
+    if (pool_pages > MAX_POOL_PAGES) {
+        pool_pages = MAX_POOL_PAGES;
+    }
+
+    // Hand the pool to the buddy allocator as the largest aligned blocks that fit
+    memset(page_map, 0, sizeof(page_map));
+    for (int i = 0; i <= MAX_ORDER; i++) {
+        free_area[i] = NULL;
+        free_blocks[i] = 0;
+    }
+    uint32_t index = 0;
+    while (index < pool_pages) {
+        uint32_t order = MAX_ORDER;
+        while ((index & ((1 << order) - 1)) != 0 || index + (1 << order) > pool_pages) {
+            order--;
+        }
+        buddy_push(&page_map[index], order);
+        index += 1 << order;
+    }
+
+#ifdef KMEM_PROFILE
+    // Forget every callsite and live allocation
+    num_kmem_sites = 0;
+    memset(kmem_live, 0, sizeof(kmem_live));
+#endif
+
+    // Create the typed caches, reserving enough objects for a full process table
+    num_caches = 0;
+    pcb_cache = cache_create("pcb", sizeof(pcb_t), MAX_PROCS);
+    pnode_cache = cache_create("pnode", sizeof(pnode_t), MAX_PROCS * 2);
+    plist_cache = cache_create("plist", sizeof(plist_t), MAX_PRIORITY + 2);
+    file_cache = cache_create("file", sizeof(fcb_t), FD_INITIAL);
+
+    // Create the general purpose caches
+    for (int i = 0; i < KMALLOC_CLASSES; i++) {
+        kmalloc_caches[i] = cache_create(kmalloc_names[i], 16 << i, 0);
+    }
+}
@@ -0,0 +1,124 @@
+#ifndef __ALLOC_H
+#define __ALLOC_H
+
+// Standard definition includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Useful constants
+#define PAGE_SIZE (0x1000)
+#define MAX_ORDER (10)
+#define MAX_POOL_PAGES (1 << MAX_ORDER)
+#define KMALLOC_CLASSES (8)
+
+// Per-callsite accounting for kmalloc/kfree, comment out to build without the bookkeeping
+#define KMEM_PROFILE
+#define MAX_KMEM_SITES (64)
+#define MAX_KMEM_LIVE (256)
+
+// Page flags
+#define PAGE_FREE (0x1)
+#define PAGE_SLAB (0x2)
+
+// Kernel memory pool set up by the linker
+extern uint32_t pool_start;
+extern uint32_t pool_end;
+
+struct kmem_cache_t;
+
+// Per-page bookkeeping
+// -- The first page of a free buddy block or of a slab holds the information for the whole block.
+typedef struct page_t {
+    struct page_t* next;
+    struct page_t* prev;
+    struct page_t* head;
+    struct kmem_cache_t* cache;
+    void* free;
+    uint16_t inuse;
+    uint8_t order;
+    uint8_t flags;
+} page_t;
+
+// Slab list
+typedef struct {
+    page_t* head;
+    uint32_t len;
+} slist_t;
+
+// Cache of equally sized objects
+typedef struct kmem_cache_t {
+    const char* name;
+    uint32_t size;
+    uint32_t order;
+    uint32_t per_slab;
+    uint32_t reserved;
+    slist_t partial;
+    slist_t full;
+    slist_t empty;
+    // Usage and fragmentation counters
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t failures;
+    uint32_t inuse;
+    uint32_t peak;
+} kmem_cache_t;
+
+// Usage of one cache, as reported to user programs
+typedef struct {
+    const char* name;
+    uint32_t size;
+    uint32_t inuse;
+    uint32_t peak;
+    uint32_t allocs;
+    uint32_t failures;
+    uint32_t wasted;
+} kmem_cache_stat_t;
+
+// Allocations made from one place in the kernel source
+typedef struct {
+    const char* file;
+    uint32_t line;
+    uint32_t live;
+    uint32_t peak;
+    uint32_t count;
+} kmem_site_t;
+
+// Typed caches for kernel objects
+extern kmem_cache_t* pcb_cache;
+extern kmem_cache_t* pnode_cache;
+extern kmem_cache_t* plist_cache;
+extern kmem_cache_t* file_cache;
+
+// Set up the buddy allocator and the kernel caches
+void alloc_init();
+
+// Page level (buddy) allocation of 2^order contiguous pages
+uint32_t alloc_pages(uint32_t order);
+void free_pages(uint32_t addr, uint32_t order);
+uint32_t free_page_count();
+
+// Object caches
+kmem_cache_t* cache_create(const char* name, uint32_t size, uint32_t reserved);
+void* cache_alloc(kmem_cache_t* cache);
+void cache_free(kmem_cache_t* cache, void* obj);
+uint32_t cache_wasted(kmem_cache_t* cache);
+int cache_stats(kmem_cache_stat_t* stats, int max);
+
+// General purpose allocation from power of 2 sized caches
+// -- With KMEM_PROFILE, kmalloc records its caller's file and line and kfree charges the free back to it.
+void* kmalloc_raw(size_t size);
+void kfree(void* ptr);
+#ifdef KMEM_PROFILE
+void* kmalloc_site(size_t size, const char* file, uint32_t line);
+void kmem_untrack(void* ptr);
+#define kmalloc(size) kmalloc_site((size), __FILE__, __LINE__)
+#else
+#define kmalloc(size) kmalloc_raw(size)
+#endif
+
+// Copy out the per-callsite counters, returns how many sites there are (or -1 without KMEM_PROFILE)
+int kmem_site_stats(kmem_site_t* stats, int max);
+
+#endif
@@ -0,0 +1,190 @@
+#include "bcache.h"
+
+// Buffers, hash chains and the LRU list (most recently used first)
+buf_t bufs[BCACHE_BUFS];
+buf_t* buf_hash[BCACHE_HASH];
+buf_t* lru_head;
+buf_t* lru_tail;
+
+// Counters
+uint32_t bcache_hits;
+uint32_t bcache_misses;
+uint32_t bcache_writebacks;
+uint32_t bcache_evictions;
+
+// Empty the cache
+void bcache_init() {
+    memset(bufs, 0, sizeof(bufs));
+    memset(buf_hash, 0, sizeof(buf_hash));
+    for (int i = 0; i < BCACHE_BUFS; i++) {
+        bufs[i].prev = i == 0 ? NULL : &bufs[i - 1];
+        bufs[i].next = i == BCACHE_BUFS - 1 ? NULL : &bufs[i + 1];
+    }
+    lru_head = &bufs[0];
+    lru_tail = &bufs[BCACHE_BUFS - 1];
+    bcache_hits = 0;
+    bcache_misses = 0;
+    bcache_writebacks = 0;
+    bcache_evictions = 0;
+}
+
+// Find the buffer holding a block (or NULL)
+buf_t* buf_find(uint32_t block) {
+    for (buf_t* b = buf_hash[block % BCACHE_HASH]; b != NULL; b = b->hash_next) {
+        if (b->block == block) {
+            return b;
+        }
+    }
+    return NULL;
+}
+
+// Take a buffer off its hash chain
+void buf_unhash(buf_t* b) {
+    buf_t** link = &buf_hash[b->block % BCACHE_HASH];
+    while (*link != b) {
+        link = &(*link)->hash_next;
+    }
+    *link = b->hash_next;
+}
+
+// Move a buffer to the front of the LRU list
+void buf_touch(buf_t* b) {
+    if (b == lru_head) {
+        return;
+    }
+    b->prev->next = b->next;
+    if (b->next != NULL) {
+        b->next->prev = b->prev;
+    } else {
+        lru_tail = b->prev;
+    }
+    b->prev = NULL;
+    b->next = lru_head;
+    lru_head->prev = b;
+    lru_head = b;
+}
+
+// Write a dirty buffer back to the disk, sending all of its sectors before waiting for any of them
+int buf_flush(buf_t* b) {
+    if (disk_wr_many(b->block * BLOCK_SECTORS, b->data, BLOCK_SECTORS) < 0) {
+        return -1;
+    }
+    b->dirty = false;
+    bcache_writebacks++;
+    return 0;
+}
+
+// Get the buffer for a block, recycling the least recently used one if it is not cached (or NULL if the disk failed)
+// -- The block is only read in if fill is set, a caller about to overwrite all of it does not need it.
+// -- A dirty buffer that cannot be written back keeps its data, and the next least recently used one is tried instead.
+buf_t* buf_get(uint32_t block, bool fill) {
+    buf_t* b = buf_find(block);
+    if (b != NULL) {
+        bcache_hits++;
+        buf_touch(b);
+        return b;
+    }
+    bcache_misses++;
+
+    b = lru_tail;
+    while (b != NULL && b->valid && b->dirty && buf_flush(b) < 0) {
+        b = b->prev;
+    }
+    if (b == NULL) {
+        return NULL;
+    }
+    if (b->valid) {
+        bcache_evictions++;
+        buf_unhash(b);
+    }
+    b->valid = false;
+    b->dirty = false;
+    b->block = block;
+    // A block that could not be read is not cached, so the next read tries the disk again
+    if (fill && disk_rd_many(block * BLOCK_SECTORS, b->data, BLOCK_SECTORS) < 0) {
+        return NULL;
+    }
+    b->valid = true;
+    b->hash_next = buf_hash[block % BCACHE_HASH];
+    buf_hash[block % BCACHE_HASH] = b;
+    buf_touch(b);
+    return b;
+}
+
+// Read len bytes at offset within a block through the cache, returns 0 (or -1 if the disk failed, with x zeroed)
+int bcache_read(uint32_t block, uint32_t offset, uint8_t* x, uint32_t len) {
+    buf_t* b = buf_get(block, true);
+    if (b == NULL) {
+        memset(x, 0, len);
+        return -1;
+    }
+    memcpy(x, b->data + offset, len);
+    return 0;
+}
+
+// Write len bytes at offset within a block through the cache, it reaches the disk when it is evicted or synced
+// -- Only a partial write needs the rest of the block read in first, returns 0 (or -1 if the disk failed).
+int bcache_write(uint32_t block, uint32_t offset, const uint8_t* x, uint32_t len) {
+    buf_t* b = buf_get(block, len < BLOCK_LENGTH);
+    // The rest of the block could not be read, so there is nothing safe to write back
+    if (b == NULL) {
+        return -1;
+    }
+    memcpy(b->data + offset, x, len);
+    b->dirty = true;
+    return 0;
+}
+
+// Zero a whole block without reading it from the disk first
+void bcache_zero(uint32_t block) {
+    buf_t* b = buf_get(block, false);
+    if (b == NULL) {
+        return;
+    }
+    memset(b->data, 0, BLOCK_LENGTH);
+    b->dirty = true;
+}
+
+// Write every dirty block back to the disk, returns how many were written (or -1 if the disk failed)
+// -- Dirty blocks are written lowest first, so the disk sees its writes in order.
+// -- A failed block stays dirty for the next sync, but each block is only tried once per pass.
+int bcache_sync() {
+    int written = 0;
+    bool failed = false;
+    bool started = false;
+    uint32_t last = 0;
+    while (1) {
+        buf_t* first = NULL;
+        for (int i = 0; i < BCACHE_BUFS; i++) {
+            if (bufs[i].dirty && (!started || bufs[i].block > last) && (first == NULL || bufs[i].block < first->block)) {
+                first = &bufs[i];
+            }
+        }
+        if (first == NULL) {
+            break;
+        }
+        started = true;
+        last = first->block;
+        if (buf_flush(first) < 0) {
+            failed = true;
+        } else {
+            written++;
+        }
+    }
+    return failed ? -1 : written;
+}
+
+// Copy out the cache counters
+void bcache_get_stats(bcache_stat_t* stats) {
+    uint32_t dirty = 0;
+    uint32_t cached = 0;
+    for (int i = 0; i < BCACHE_BUFS; i++) {
+        if (bufs[i].valid) {
+            cached++;
+        }
+        if (bufs[i].dirty) {
+            dirty++;
+        }
+    }
+    *stats = (bcache_stat_t) {bcache_hits, bcache_misses, bcache_writebacks, bcache_evictions, dirty, cached};
+}
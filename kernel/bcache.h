@@ -0,0 +1,63 @@
+#ifndef __BCACHE_H
+#define __BCACHE_H
+
+// Standard definition includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Disk driver
+#include "disk.h"
+
+// Disk sectors, and the filesystem block made up of BLOCK_SECTORS of them
+// -- BLOCK_SECTORS must be a power of two no bigger than a page (64), and the disk has to be formatted to match.
+#define SECTOR_LENGTH (64)
+#ifndef BLOCK_SECTORS
+#define BLOCK_SECTORS (8)
+#endif
+#define BLOCK_LENGTH (BLOCK_SECTORS * SECTOR_LENGTH)
+
+// Useful constants
+#define BCACHE_BUFS (64)
+#define BCACHE_HASH (64)
+
+// Cached copy of one filesystem block, on a hash chain by block number and on the LRU list
+typedef struct buf_t {
+    bool valid;
+    bool dirty;
+    uint32_t block;
+    struct buf_t* hash_next;
+    struct buf_t* prev;
+    struct buf_t* next;
+    uint8_t data[BLOCK_LENGTH];
+} buf_t;
+
+// Buffer cache counters, as reported to user programs
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t writebacks;
+    uint32_t evictions;
+    uint32_t dirty;
+    uint32_t cached;
+} bcache_stat_t;
+
+// Empty the cache
+void bcache_init();
+
+// Read or write len bytes at offset within a block through the cache, returns 0 (or -1 if the disk failed)
+// -- Writes only mark the block dirty, it reaches the disk when it is evicted or synced.
+// -- A failed read fills x with zeroes rather than leaving whatever the buffer last held.
+int bcache_read(uint32_t block, uint32_t offset, uint8_t* x, uint32_t len);
+int bcache_write(uint32_t block, uint32_t offset, const uint8_t* x, uint32_t len);
+// Zero a whole block without reading it from the disk first
+void bcache_zero(uint32_t block);
+
+// Write every dirty block back to the disk, returns how many were written (or -1 if the disk failed)
+int bcache_sync();
+
+// Copy out the cache counters
+void bcache_get_stats(bcache_stat_t* stats);
+
+#endif
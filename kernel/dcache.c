@@ -0,0 +1,149 @@
+#include "dcache.h"
+
+// Entries, hash chains and the LRU list (most recently used first)
+dentry_t dentries[DCACHE_ENTRIES];
+dentry_t* dentry_hash[DCACHE_HASH];
+dentry_t* dlru_head;
+dentry_t* dlru_tail;
+
+// Counters
+uint32_t dcache_hits;
+uint32_t dcache_negative;
+uint32_t dcache_misses;
+uint32_t dcache_evictions;
+
+// Empty the cache
+void dcache_init() {
+    memset(dentries, 0, sizeof(dentries));
+    memset(dentry_hash, 0, sizeof(dentry_hash));
+    for (int i = 0; i < DCACHE_ENTRIES; i++) {
+        dentries[i].prev = i == 0 ? NULL : &dentries[i - 1];
+        dentries[i].next = i == DCACHE_ENTRIES - 1 ? NULL : &dentries[i + 1];
+    }
+    dlru_head = &dentries[0];
+    dlru_tail = &dentries[DCACHE_ENTRIES - 1];
+    dcache_hits = 0;
+    dcache_negative = 0;
+    dcache_misses = 0;
+    dcache_evictions = 0;
+}
+
+// Get the hash chain for a name in a directory
+dentry_t** dentry_chain(int parent, const char* name) {
+    return &dentry_hash[(name_hash(name) ^ (uint32_t) parent * 2654435761u) % DCACHE_HASH];
+}
+
+// Find the entry for a name in a directory (or NULL)
+dentry_t* dentry_find(int parent, const char* name) {
+    for (dentry_t* d = *dentry_chain(parent, name); d != NULL; d = d->hash_next) {
+        if (d->parent == parent && strncmp(d->name, name, DIR_NAME_LENGTH - 1) == 0) {
+            return d;
+        }
+    }
+    return NULL;
+}
+
+// Take an entry off its hash chain, leaving it free to be reused
+void dentry_drop(dentry_t* d) {
+    dentry_t** link = dentry_chain(d->parent, d->name);
+    while (*link != d) {
+        link = &(*link)->hash_next;
+    }
+    *link = d->hash_next;
+    d->valid = false;
+}
+
+// Move an entry to the front (or the back, once it is free) of the LRU list
+void dentry_move(dentry_t* d, bool front) {
+    if (d == (front ? dlru_head : dlru_tail)) {
+        return;
+    }
+    if (d->prev != NULL) {
+        d->prev->next = d->next;
+    } else {
+        dlru_head = d->next;
+    }
+    if (d->next != NULL) {
+        d->next->prev = d->prev;
+    } else {
+        dlru_tail = d->prev;
+    }
+    if (front) {
+        d->prev = NULL;
+        d->next = dlru_head;
+        dlru_head->prev = d;
+        dlru_head = d;
+    } else {
+        d->next = NULL;
+        d->prev = dlru_tail;
+        dlru_tail->next = d;
+        dlru_tail = d;
+    }
+}
+
+// Find a name in the directory with inode number parent, returns 0 having filled in its entry (or -1 if it is not there)
+// -- Only a miss reads the directory, and its answer (found or not) is cached for next time in the least recently used entry.
+int dcache_lookup(int parent, const char* name, dir_entry_t* entry) {
+    dentry_t* d = dentry_find(parent, name);
+    if (d != NULL) {
+        dcache_hits++;
+        dentry_move(d, true);
+        if (d->inode_num == -1) {
+            dcache_negative++;
+            return -1;
+        }
+        *entry = (dir_entry_t) {d->inode_num, d->type};
+        memcpy(entry->name, d->name, DIR_NAME_LENGTH);
+        return 0;
+    }
+    dcache_misses++;
+
+    inode_t dir;
+    read_inode_block(parent, &dir);
+    int r = dir_lookup(&dir, name, entry);
+
+    d = dlru_tail;
+    if (d->valid) {
+        dcache_evictions++;
+        dentry_drop(d);
+    }
+    d->valid = true;
+    d->parent = parent;
+    d->inode_num = r == 0 ? (int) entry->inode_num : -1;
+    d->type = r == 0 ? entry->type : DATA;
+    memset(d->name, 0, DIR_NAME_LENGTH);
+    strncpy(d->name, name, DIR_NAME_LENGTH - 1);
+    dentry_t** chain = dentry_chain(parent, d->name);
+    d->hash_next = *chain;
+    *chain = d;
+    dentry_move(d, true);
+    return r;
+}
+
+// Forget what is cached for a name in a directory, whenever it is created or removed
+void dcache_forget(int parent, const char* name) {
+    dentry_t* d = dentry_find(parent, name);
+    if (d != NULL) {
+        dentry_drop(d);
+        dentry_move(d, false);
+    }
+}
+
+// Forget every name cached in a directory, once it is removed and its inode number may be reused
+void dcache_forget_dir(int parent) {
+    for (int i = 0; i < DCACHE_ENTRIES; i++) {
+        if (dentries[i].valid && dentries[i].parent == parent) {
+            dentry_drop(&dentries[i]);
+            dentry_move(&dentries[i], false);
+        }
+    }
+}
+
+// Copy out the cache counters
+void dcache_get_stats(dcache_stat_t* stats) {
+    uint32_t cached = 0;
+    for (int i = 0; i < DCACHE_ENTRIES; i++) {
+        cached += dentries[i].valid;
+    }
+    *stats = (dcache_stat_t) {dcache_hits, dcache_negative, dcache_misses, dcache_evictions, cached};
+}
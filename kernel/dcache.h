@@ -0,0 +1,55 @@
+#ifndef __DCACHE_H
+#define __DCACHE_H
+
+// Standard definition includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Directories
+#include "dir.h"
+
+// Useful constants
+#define DCACHE_ENTRIES (128)
+#define DCACHE_HASH (64)
+
+// Cached result of looking a name up in a directory, on a hash chain by directory and name and on the LRU list
+// -- A negative entry (inode_num of -1) remembers that the name is not there.
+typedef struct dentry_t {
+    bool valid;
+    int parent;
+    int inode_num;
+    file_t type;
+    char name[DIR_NAME_LENGTH];
+    struct dentry_t* hash_next;
+    struct dentry_t* prev;
+    struct dentry_t* next;
+} dentry_t;
+
+// Name cache counters, as reported to user programs
+// -- negative counts the hits that found a name missing, cached is the entries held right now.
+typedef struct {
+    uint32_t hits;
+    uint32_t negative;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t cached;
+} dcache_stat_t;
+
+// Empty the cache
+void dcache_init();
+
+// Find a name in the directory with inode number parent, returns 0 having filled in its entry (or -1 if it is not there)
+// -- Only a miss reads the directory, and its answer (found or not) is cached for next time.
+int dcache_lookup(int parent, const char* name, dir_entry_t* entry);
+
+// Forget what is cached for a name in a directory, whenever it is created or removed
+void dcache_forget(int parent, const char* name);
+// Forget every name cached in a directory, once it is removed and its inode number may be reused
+void dcache_forget_dir(int parent);
+
+// Copy out the cache counters
+void dcache_get_stats(dcache_stat_t* stats);
+
+#endif
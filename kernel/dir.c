@@ -0,0 +1,253 @@
+#include "dir.h"
+
+// Hash a name, only the part that fits in a directory entry counts (32 bit FNV-1a)
+uint32_t name_hash(const char* name) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < DIR_NAME_LENGTH - 1 && name[i] != '\0'; i++) {
+        h = (h ^ (uint8_t) name[i]) * 16777619u;
+    }
+    return h;
+}
+
+// Read or write part of one of a directory's blocks
+// -- Every block a directory uses is claimed as it grows, so a missing one only comes from a damaged directory and reads as zeroes.
+void dir_read(inode_t* dir, uint32_t index, uint32_t offset, void* x, uint32_t len) {
+    int block = inode_map(dir, index, false);
+    if (block == -1) {
+        memset(x, 0, len);
+    } else {
+        bcache_read(DATA_START + block, offset, x, len);
+    }
+}
+
+void dir_write(inode_t* dir, uint32_t index, uint32_t offset, const void* x, uint32_t len) {
+    int block = inode_map(dir, index, false);
+    if (block != -1) {
+        bcache_write(DATA_START + block, offset, x, len);
+    }
+}
+
+// Read a directory's header
+void dir_header(inode_t* dir, dir_header_t* header) {
+    dir_read(dir, 0, 0, header, sizeof(dir_header_t));
+}
+
+// Read or write slot i of the hash index
+uint32_t dir_slot(inode_t* dir, dir_header_t* h, uint32_t i) {
+    uint32_t slot;
+    dir_read(dir, h->index[i / PTRS_PER_BLOCK], (i % PTRS_PER_BLOCK) * 4, &slot, 4);
+    return slot;
+}
+
+void dir_set_slot(inode_t* dir, dir_header_t* h, uint32_t i, uint32_t slot) {
+    dir_write(dir, h->index[i / PTRS_PER_BLOCK], (i % PTRS_PER_BLOCK) * 4, &slot, 4);
+}
+
+// Add a block to the end of a directory with every entry free, returns its number within the directory (or -1 if the disk is full)
+int dir_grow(inode_t* dir, dir_header_t* h) {
+    int block = inode_map(dir, h->blocks, true);
+    if (block == -1) {
+        return -1;
+    }
+    bcache_zero(DATA_START + block);
+    uint32_t none = ENTRY_FREE;
+    for (int i = 0; i < DIR_ENTRIES_PER_BLOCK; i++) {
+        bcache_write(DATA_START + block, i * DIR_ENTRY_LENGTH, (uint8_t*) &none, 4);
+    }
+    dir->size = (h->blocks + 1) * BLOCK_LENGTH;
+    return h->blocks++;
+}
+
+// Find a name in a bucket, returns its place in the bucket having filled in its entry (or -1)
+// -- The bucket is mapped to its data block once, rather than for every entry.
+int bucket_find(inode_t* dir, uint32_t bucket, const char* name, dir_entry_t* entry) {
+    int block = inode_map(dir, bucket, false);
+    for (int i = 0; block != -1 && i < DIR_ENTRIES_PER_BLOCK; i++) {
+        bcache_read(DATA_START + block, i * DIR_ENTRY_LENGTH, (uint8_t*) entry, sizeof(dir_entry_t));
+        if (entry->inode_num != ENTRY_FREE && strncmp(entry->name, name, DIR_NAME_LENGTH - 1) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Find a free place in a bucket (or -1 if it is full)
+int bucket_free(inode_t* dir, uint32_t bucket) {
+    int block = inode_map(dir, bucket, false);
+    for (int i = 0; block != -1 && i < DIR_ENTRIES_PER_BLOCK; i++) {
+        uint32_t inode_num;
+        bcache_read(DATA_START + block, i * DIR_ENTRY_LENGTH, (uint8_t*) &inode_num, 4);
+        if (inode_num == ENTRY_FREE) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+/**********************************
+ * GROWING THE INDEX
+**********************************/
+
+// Double the hash index, the new upper half of the slots pointing at the same buckets as the lower half
+// -- Returns 0, or -1 if the index is as big as it can get or the disk is full.
+int dir_double(inode_t* dir, dir_header_t* h) {
+    uint32_t slots = 1u << h->depth;
+    if (slots * 2 > DIR_MAX_SLOTS) {
+        return -1;
+    }
+    for (uint32_t b = slots / PTRS_PER_BLOCK; b < slots * 2 / PTRS_PER_BLOCK; b++) {
+        if (h->index[b] == -1) {
+            int block = dir_grow(dir, h);
+            if (block == -1) {
+                return -1;
+            }
+            h->index[b] = block;
+        }
+    }
+    for (uint32_t i = 0; i < slots; i++) {
+        dir_set_slot(dir, h, slots + i, dir_slot(dir, h, i));
+    }
+    h->depth++;
+    return 0;
+}
+
+// Split the full bucket behind slot i in two by the next bit of the hash, doubling the index first if the bucket uses every bit the index has
+// -- Returns 0, or -1 if the index is as big as it can get or the disk is full.
+int dir_split(inode_t* dir, dir_header_t* h, uint32_t i, uint32_t slot) {
+    uint32_t old = SLOT_BLOCK(slot);
+    uint32_t depth = SLOT_DEPTH(slot);
+    if (depth == h->depth && dir_double(dir, h) == -1) {
+        return -1;
+    }
+    int new = dir_grow(dir, h);
+    if (new == -1) {
+        return -1;
+    }
+
+    // Every slot sharing the bucket's depth low bits pointed at it, those with the next bit set now point at the new bucket
+    uint32_t bit = 1u << depth;
+    for (uint32_t j = i & (bit - 1); j < (1u << h->depth); j += bit) {
+        dir_set_slot(dir, h, j, (j & bit) ? SLOT(new, depth + 1) : SLOT(old, depth + 1));
+    }
+
+    // Move the names with the next bit set across
+    int from = inode_map(dir, old, false);
+    int to = inode_map(dir, new, false);
+    dir_entry_t entry;
+    uint32_t none = ENTRY_FREE;
+    int moved = 0;
+    for (int k = 0; from != -1 && k < DIR_ENTRIES_PER_BLOCK; k++) {
+        bcache_read(DATA_START + from, k * DIR_ENTRY_LENGTH, (uint8_t*) &entry, sizeof(dir_entry_t));
+        if (entry.inode_num != ENTRY_FREE && (name_hash(entry.name) & bit)) {
+            bcache_write(DATA_START + to, moved++ * DIR_ENTRY_LENGTH, (uint8_t*) &entry, sizeof(dir_entry_t));
+            bcache_write(DATA_START + from, k * DIR_ENTRY_LENGTH, (uint8_t*) &none, 4);
+        }
+    }
+    return 0;
+}
+
+
+/**********************************
+ * DIRECTORY OPERATIONS
+**********************************/
+
+// Lay out an empty directory in a new inode, returns 0 (or -1 if the disk is full)
+// -- The header comes first, then the first index block with its one slot, then the one bucket that slot points at.
+int dir_create(inode_t* dir, int parent, const char* name) {
+    dir->type = DIRECTORY;
+    dir->size = 0;
+    for (int i = 0; i < 12; i++) {
+        dir->directptrs[i] = -1;
+    }
+    dir->indirect = -1;
+    dir->double_indirect = -1;
+
+    dir_header_t h = {0, 0, 0, parent};
+    strncpy(h.name, name, DIR_NAME_LENGTH - 1);
+    memset(h.index, 0xFF, sizeof(h.index));
+    for (int i = 0; i < DIR_NEW_BLOCKS; i++) {
+        if (dir_grow(dir, &h) == -1) {
+            inode_truncate(dir, 0);
+            return -1;
+        }
+    }
+    h.index[0] = 1;
+    dir_set_slot(dir, &h, 0, SLOT(2, 0));
+    dir_write(dir, 0, 0, &h, sizeof(dir_header_t));
+    return 0;
+}
+
+// Find a name in a directory, returns 0 having filled in its entry (or -1 if it is not there)
+// -- This reads the header, one block of the index and one bucket, however big the directory is.
+int dir_lookup(inode_t* dir, const char* name, dir_entry_t* entry) {
+    dir_header_t h;
+    dir_header(dir, &h);
+    uint32_t slot = dir_slot(dir, &h, name_hash(name) & ((1u << h.depth) - 1));
+    return bucket_find(dir, SLOT_BLOCK(slot), name, entry) == -1 ? -1 : 0;
+}
+
+// Add an entry to a directory, returns 0 (or -1 if the directory or the disk is full)
+// -- A full bucket is split until the name's half has room, which only fails once the index is at its largest.
+int dir_add(inode_t* dir, const dir_entry_t* entry) {
+    dir_header_t h;
+    dir_header(dir, &h);
+    uint32_t hash = name_hash(entry->name);
+    int r = 0;
+    while (true) {
+        uint32_t i = hash & ((1u << h.depth) - 1);
+        uint32_t slot = dir_slot(dir, &h, i);
+        int place = bucket_free(dir, SLOT_BLOCK(slot));
+        if (place != -1) {
+            dir_write(dir, SLOT_BLOCK(slot), place * DIR_ENTRY_LENGTH, entry, sizeof(dir_entry_t));
+            h.entries++;
+            break;
+        }
+        if (dir_split(dir, &h, i, slot) == -1) {
+            r = -1;
+            break;
+        }
+    }
+    // Splits may have changed the header even if the entry did not fit
+    dir_write(dir, 0, 0, &h, sizeof(dir_header_t));
+    return r;
+}
+
+// Remove a name from a directory, returns 0 (or -1 if it is not there)
+// -- Buckets are never merged back, an emptied bucket just has room for later names.
+int dir_remove(inode_t* dir, const char* name) {
+    dir_header_t h;
+    dir_header(dir, &h);
+    uint32_t slot = dir_slot(dir, &h, name_hash(name) & ((1u << h.depth) - 1));
+    dir_entry_t entry;
+    int i = bucket_find(dir, SLOT_BLOCK(slot), name, &entry);
+    if (i == -1) {
+        return -1;
+    }
+    uint32_t none = ENTRY_FREE;
+    dir_write(dir, SLOT_BLOCK(slot), i * DIR_ENTRY_LENGTH, &none, 4);
+    h.entries--;
+    dir_write(dir, 0, offsetof(dir_header_t, entries), &h.entries, 4);
+    return 0;
+}
+
+// Step through the entries of a directory, returns 0 having filled in the next entry (or -1 at the end)
+// -- pos is a slot and a place in its bucket, a bucket is only visited from the lowest slot that points at it.
+int dir_next(inode_t* dir, uint32_t* pos, dir_entry_t* entry) {
+    dir_header_t h;
+    dir_header(dir, &h);
+    while (*pos < (1u << h.depth) * DIR_ENTRIES_PER_BLOCK) {
+        uint32_t i = *pos / DIR_ENTRIES_PER_BLOCK;
+        uint32_t slot = dir_slot(dir, &h, i);
+        if (i >= (1u << SLOT_DEPTH(slot))) {
+            *pos = (i + 1) * DIR_ENTRIES_PER_BLOCK;
+            continue;
+        }
+        dir_read(dir, SLOT_BLOCK(slot), (*pos % DIR_ENTRIES_PER_BLOCK) * DIR_ENTRY_LENGTH, entry, sizeof(dir_entry_t));
+        (*pos)++;
+        if (entry->inode_num != ENTRY_FREE) {
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,64 @@
+#ifndef __DIR_H
+#define __DIR_H
+
+// Standard definition includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Inodes and the blocks of a file
+#include "file.h"
+
+// Directory layout, in blocks of the directory itself, format.py lays the root directory out the same way
+// -- Block 0 is the header, and every other block is either a block of the hash index or a bucket of DIR_ENTRIES_PER_BLOCK entries.
+// -- The index has 1 << depth slots, a name goes in the bucket of the slot picked by the low depth bits of its hash.
+// -- A slot holds the bucket's block in its low 24 bits and the bucket's own depth (how many hash bits its names share) in its top 8.
+// -- With 512 byte blocks the index can grow to 8192 slots, enough for well over 10000 names.
+#define DIR_INDEX_BLOCKS (BLOCK_LENGTH / 8)
+#define DIR_MAX_SLOTS (DIR_INDEX_BLOCKS * PTRS_PER_BLOCK)
+#define SLOT_BLOCK(s) ((s) & 0xFFFFFF)
+#define SLOT_DEPTH(s) ((s) >> 24)
+#define SLOT(block, depth) ((uint32_t) (block) | (uint32_t) (depth) << 24)
+
+// A new directory has its header, one index block and one bucket
+#define DIR_NEW_BLOCKS (3)
+
+#if BLOCK_LENGTH < 256
+#error "Directories need blocks of at least 256 bytes (BLOCK_SECTORS of 4 or more)"
+#endif
+
+// Header kept in block 0 of a directory
+// -- index gives the directory block holding each block of the hash index (-1 until the index grows into it).
+// -- parent and name say where the directory sits, the root directory is its own parent and has no name.
+typedef struct {
+    uint32_t depth;
+    uint32_t entries;
+    uint32_t blocks;
+    uint32_t parent;
+    char name[DIR_NAME_LENGTH];
+    uint32_t index[DIR_INDEX_BLOCKS];
+} dir_header_t;
+
+// Hash a name, as used to pick its bucket
+uint32_t name_hash(const char* name);
+
+// Lay out an empty directory in a new inode, returns 0 (or -1 if the disk is full)
+// -- The caller writes the inode back.
+int dir_create(inode_t* dir, int parent, const char* name);
+
+// Find a name in a directory, returns 0 having filled in its entry (or -1 if it is not there)
+int dir_lookup(inode_t* dir, const char* name, dir_entry_t* entry);
+// Add an entry to a directory, returns 0 (or -1 if the directory or the disk is full)
+// -- The caller checks the name is not there already, and writes the inode back.
+int dir_add(inode_t* dir, const dir_entry_t* entry);
+// Remove a name from a directory, returns 0 (or -1 if it is not there)
+int dir_remove(inode_t* dir, const char* name);
+
+// Step through the entries of a directory, returns 0 having filled in the next entry (or -1 at the end)
+// -- pos starts at 0 and is moved on by each call.
+int dir_next(inode_t* dir, uint32_t* pos, dir_entry_t* entry);
+// Read a directory's header
+void dir_header(inode_t* dir, dir_header_t* header);
+
+#endif
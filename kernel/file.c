@@ -1,127 +1,303 @@
 #include "file.h"
+#include "icache.h"
 
-// Read an inode from the disk
+// Read an inode, copied from the in-core inode table (see icache.h)
 void read_inode_block(int inode_num, inode_t* inode) {
-    uint8_t block[BLOCK_LENGTH] = {0};
-    disk_rd(inode_num + BITMAP_LENGTH, block);
-    memcpy(inode, block, sizeof(inode_t));
+    memcpy(inode, icache_inode(inode_num), sizeof(inode_t));
 }
 
-// Write an inode to the disk
+// Write an inode, it reaches its inode block at the next sync
 void write_inode_block(int inode_num, inode_t* inode) {
-    uint8_t block[BLOCK_LENGTH] = {0};
-    memcpy(block, inode, sizeof(inode_t));
-    disk_wr(inode_num + BITMAP_LENGTH, block);
-}
-
-// Read a directory entry from the disk
-void write_dir_entry(int data_block_num, dir_entry_t* dir_entry) {
-    uint8_t block[BLOCK_LENGTH] = {0};
-    memcpy(block, dir_entry, sizeof(dir_entry_t));
-    write_data_block(data_block_num, block);
-}
-
-// Write a directory entry to the disk
-void read_dir_entry(int data_block_num, dir_entry_t* dir_entry) {
-    uint8_t block[BLOCK_LENGTH] = {0};
-    read_data_block(data_block_num, block);
-    memcpy(dir_entry, block, sizeof(dir_entry_t));
+    icache_set(inode_num, inode);
 }
 
 // Write a data block to the disk
 void write_data_block(int data_block_num, uint8_t* block) {
-    disk_wr(data_block_num + BITMAP_LENGTH + INODES, block);
+    bcache_write(DATA_START + data_block_num, 0, block, BLOCK_LENGTH);
 }
 
 // Read a data block from the disk
 void read_data_block(int data_block_num, uint8_t* block) {
-    disk_rd(data_block_num + BITMAP_LENGTH + INODES, block);
-}
-
-// Add data to a specific inode's data pointer
-void add_inode_data(inode_t *inode, int inode_num, int ptr, uint8_t* block) {
-    // Check if there was data there already, free those blocks
-    if (inode->directptrs[ptr] != -1) {
-        free_data_block(inode->directptrs[ptr]);
-    }
-
-    // Create a new data block and add a pointer to it
-    inode->directptrs[ptr] = claim_data_block();
-    write_data_block(inode->directptrs[ptr], block);
-    write_inode_block(inode_num, inode);
-}
-
-// Checks the bitmap blocks to see whether the given block number is free
-int check_and_claim_block(int block_num) {
-    // Calculate the correct bitmap block then byte then bit for this block number
-    int bm_block = block_num / 512;
-    int bm_byte = (block_num % 512) / 8;
-    int bm_bit = block_num % 8;
-
-    // Load the bitmap block for the given block number
-    uint8_t block[BLOCK_LENGTH] = {0};
-    disk_rd(bm_block, block);
-    // Check if the corresponding bit is 0 (i.e. the block is free)
-    if (~block[bm_byte] & (1 << bm_bit)) {
-        // Set the correct bit to indicate a taken block
-        block[bm_byte] |= 1 << bm_bit;
-        disk_wr(bm_block, block);
-        return 1;
-    }
-    
-    // Otherwise block wasn't free
-    return 0;
-}
-
-// Free a block from the bitmap
-void free_block(int block_num) {
-    // Calculate the correct bitmap block then byte then bit for this block number
-    int bm_block = block_num / 512;
-    int bm_byte = (block_num % 512) / 8;
-    int bm_bit = block_num % 8;
-    
-    // Clear the desired block from the bitmap
-    uint8_t block[BLOCK_LENGTH] = {0};
-    disk_rd(bm_block, block);
-    if (bm_bit == 0) {
-        block[bm_byte] &= 0xFE;
-    } else {
-        uint8_t mask = (0 << bm_bit) | ((1 << bm_bit) - 1);
-        for (int i = bm_bit + 1; i < 8; i++) {
-            mask |= (1 << i);
+    bcache_read(DATA_START + data_block_num, 0, block, BLOCK_LENGTH);
+}
+
+
+/**********************************
+ * FILE BLOCK MAPPING
+**********************************/
+
+// Pointer block with every pointer unused, copied into each new indirect block
+uint32_t no_ptrs[PTRS_PER_BLOCK];
+
+// Read and write one pointer of an indirect block, a pointer that cannot be read is unused (or -1)
+uint32_t get_ptr(uint32_t block, uint32_t i) {
+    uint32_t ptr;
+    if (bcache_read(DATA_START + block, i * 4, (uint8_t*) &ptr, 4) == -1) {
+        return -1;
+    }
+    return ptr;
+}
+
+int set_ptr(uint32_t block, uint32_t i, uint32_t ptr) {
+    return bcache_write(DATA_START + block, i * 4, (const uint8_t*) &ptr, 4);
+}
+
+// Claim a data block for use as an indirect block, with every pointer unused (or -1)
+int claim_ptr_block() {
+    int block = claim_data_block();
+    if (block != -1) {
+        bcache_write(DATA_START + block, 0, (const uint8_t*) no_ptrs, BLOCK_LENGTH);
+    }
+    return block;
+}
+
+// Follow (or, if alloc is set, create) pointer i of an indirect block, the target is a fresh indirect block if ptrs is set
+// -- Returns the block pointed to, or -1 if there is none and it could not (or was not to) be created.
+int follow_ptr(uint32_t block, uint32_t i, bool alloc, bool ptrs) {
+    uint32_t ptr = get_ptr(block, i);
+    if (ptr == -1 && alloc) {
+        ptr = ptrs ? claim_ptr_block() : claim_data_block();
+        // A pointer block that cannot be read cannot be written either, so give the new block back
+        if (ptr != -1 && set_ptr(block, i, ptr) == -1) {
+            free_data_block(ptr);
+            ptr = -1;
         }
-        block[bm_byte] &= mask;
     }
-    disk_wr(bm_block, block);
+    return ptr;
 }
 
-// Claim the first available inode block
-int claim_inode_block() {
-    for (int i = 0; i < INODES; i++) {
-        if (check_and_claim_block(i)) {
-            return i;
+// Get the data block holding block index of a file (or -1 if it has none), creating it (and any indirect blocks) if alloc is set
+// -- The first 12 blocks are direct, then PTRS_PER_BLOCK through the single indirect block and the rest through the double.
+// -- Creating blocks may change the inode, which the caller writes back.
+int inode_map(inode_t* inode, uint32_t index, bool alloc) {
+    if (index < 12) {
+        if (inode->directptrs[index] == -1 && alloc) {
+            inode->directptrs[index] = claim_data_block();
         }
+        return inode->directptrs[index];
     }
-    return -1;
+    index -= 12;
+    if (index < PTRS_PER_BLOCK) {
+        if (inode->indirect == -1 && alloc) {
+            inode->indirect = claim_ptr_block();
+        }
+        return inode->indirect == -1 ? -1 : follow_ptr(inode->indirect, index, alloc, false);
+    }
+    index -= PTRS_PER_BLOCK;
+    if (index >= PTRS_PER_BLOCK * PTRS_PER_BLOCK) {
+        return -1;
+    }
+    if (inode->double_indirect == -1 && alloc) {
+        inode->double_indirect = claim_ptr_block();
+    }
+    if (inode->double_indirect == -1) {
+        return -1;
+    }
+    int middle = follow_ptr(inode->double_indirect, index / PTRS_PER_BLOCK, alloc, true);
+    return middle == -1 ? -1 : follow_ptr(middle, index % PTRS_PER_BLOCK, alloc, false);
 }
 
-// Claim the first available data block
-int claim_data_block() {
-    for (int i = 0; i < DATA_BLOCKS; i++) {
-        if (check_and_claim_block(i + INODES)) {
-            return i;
+// Free the pointers from first onwards in an indirect block, through a further level of indirect blocks if ptrs is set
+// -- Returns 1 if the block has no pointers left, so it can be freed itself.
+int free_ptrs(uint32_t block, uint32_t first, bool ptrs) {
+    for (uint32_t i = 0; i < PTRS_PER_BLOCK; i++) {
+        uint32_t ptr = get_ptr(block, i);
+        if (ptr == -1) {
+            continue;
+        }
+        if (ptrs) {
+            // Only the first middle block can be kept, and only for the pointers before first
+            uint32_t keep = i * PTRS_PER_BLOCK >= first ? 0 : first - i * PTRS_PER_BLOCK;
+            if (keep < PTRS_PER_BLOCK && free_ptrs(ptr, keep, false)) {
+                free_data_block(ptr);
+                set_ptr(block, i, -1);
+            }
+        } else if (i >= first) {
+            free_data_block(ptr);
+            set_ptr(block, i, -1);
+        }
+    }
+    for (uint32_t i = 0; i < PTRS_PER_BLOCK; i++) {
+        if (get_ptr(block, i) != -1) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Free every block of a file from block index blocks onwards, along with any indirect blocks left empty
+void inode_truncate(inode_t* inode, uint32_t blocks) {
+    for (uint32_t i = blocks; i < 12; i++) {
+        if (inode->directptrs[i] != -1) {
+            free_data_block(inode->directptrs[i]);
+            inode->directptrs[i] = -1;
+        }
+    }
+    uint32_t first = blocks < 12 ? 0 : blocks - 12;
+    if (inode->indirect != -1 && first < PTRS_PER_BLOCK && free_ptrs(inode->indirect, first, false)) {
+        free_data_block(inode->indirect);
+        inode->indirect = -1;
+    }
+    first = first < PTRS_PER_BLOCK ? 0 : first - PTRS_PER_BLOCK;
+    if (inode->double_indirect != -1 && free_ptrs(inode->double_indirect, first, true)) {
+        free_data_block(inode->double_indirect);
+        inode->double_indirect = -1;
+    }
+}
+
+// Read up to len bytes of a file starting at offset, returns how many were read (0 at or past the end)
+// -- A block the file never wrote reads as zeroes.
+int inode_read(inode_t* inode, uint32_t offset, uint8_t* x, uint32_t len) {
+    if (offset >= inode->size) {
+        return 0;
+    }
+    if (len > inode->size - offset) {
+        len = inode->size - offset;
+    }
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t pos = offset + done;
+        uint32_t within = pos % BLOCK_LENGTH;
+        uint32_t n = len - done < BLOCK_LENGTH - within ? len - done : BLOCK_LENGTH - within;
+        int block = inode_map(inode, pos / BLOCK_LENGTH, false);
+        if (block == -1) {
+            memset(x + done, 0, n);
+        } else {
+            bcache_read(DATA_START + block, within, x + done, n);
+        }
+        done += n;
+    }
+    return done;
+}
+
+// Write len bytes of data into a file starting at offset, returns how many were written
+// -- Only the blocks touched are written, in place, and the write stops short if the disk fills up or fails, or the file reaches its largest size.
+// -- A new block that is only partly written has the rest zeroed, and the size grows if the write ends past it.
+// -- The caller writes the inode back.
+int inode_write(inode_t* inode, uint32_t offset, const uint8_t* data, uint32_t len) {
+    if (offset >= MAX_FILE_LENGTH) {
+        return 0;
+    }
+    if (len > MAX_FILE_LENGTH - offset) {
+        len = MAX_FILE_LENGTH - offset;
+    }
+    uint32_t done = 0;
+    while (done < len) {
+        uint32_t pos = offset + done;
+        uint32_t within = pos % BLOCK_LENGTH;
+        uint32_t n = len - done < BLOCK_LENGTH - within ? len - done : BLOCK_LENGTH - within;
+        bool fresh = inode_map(inode, pos / BLOCK_LENGTH, false) == -1;
+        int block = inode_map(inode, pos / BLOCK_LENGTH, true);
+        if (block == -1) {
+            break;
+        }
+        if (fresh && n < BLOCK_LENGTH) {
+            bcache_zero(DATA_START + block);
+        }
+        if (bcache_write(DATA_START + block, within, data + done, n) == -1) {
+            break;
+        }
+        done += n;
+    }
+    if (offset + done > inode->size) {
+        inode->size = offset + done;
+    }
+    return done;
+}
+
+/**********************************
+ * FREE SPACE BITMAPS
+**********************************/
+
+// Both bitmaps, held in memory from mount onwards, with bit n (least significant first) set while block n is taken
+// -- Inodes are blocks 0 to INODES - 1 of the bitmap and data blocks follow them.
+uint32_t bitmap[BITMAP_WORDS];
+// Bitmap blocks changed since they were last written out
+bool bitmap_dirty[BITMAP_LENGTH];
+// Words to start the next search for a free inode and data block from
+uint32_t inode_hint;
+uint32_t data_hint;
+
+// Load the bitmaps from the disk
+void fs_mount() {
+    for (int i = 0; i < BITMAP_LENGTH; i++) {
+        bcache_read(i, 0, (uint8_t*) bitmap + i * BLOCK_LENGTH, BLOCK_LENGTH);
+        bitmap_dirty[i] = false;
+    }
+    memset(no_ptrs, 0xFF, sizeof(no_ptrs));
+    inode_hint = 0;
+    data_hint = INODES / 32;
+}
+
+// Write the changed inodes, the changed bitmap blocks and every other modified block back to the disk, returns how many blocks were written (or -1)
+int fs_sync() {
+    icache_sync();
+    for (int i = 0; i < BITMAP_LENGTH; i++) {
+        if (bitmap_dirty[i]) {
+            bcache_write(i, 0, (uint8_t*) bitmap + i * BLOCK_LENGTH, BLOCK_LENGTH);
+            bitmap_dirty[i] = false;
+        }
+    }
+    return bcache_sync();
+}
+
+// Set or clear the bit for a block, marking its bitmap block for writing out
+void bitmap_set(int block_num, bool taken) {
+    if (taken) {
+        bitmap[block_num / 32] |= 1u << (block_num % 32);
+    } else {
+        bitmap[block_num / 32] &= ~(1u << (block_num % 32));
+    }
+    bitmap_dirty[block_num / (BLOCK_LENGTH * 8)] = true;
+}
+
+// Claim the first free block in [first, last), searching a word at a time from the hint and wrapping round once
+// -- Returns the block number (or -1), and moves the hint to the word it was found in.
+int bitmap_claim(int first, int last, uint32_t* hint) {
+    int words = (last - 1) / 32 - first / 32 + 1;
+    uint32_t w = *hint;
+    for (int i = 0; i < words; i++, w++) {
+        if (w > (last - 1) / 32) {
+            w = first / 32;
+        }
+        // Treat bits outside the range as taken
+        uint32_t taken = bitmap[w];
+        if (w == first / 32 && first % 32 != 0) {
+            taken |= (1u << (first % 32)) - 1;
+        }
+        if (w == (last - 1) / 32 && last % 32 != 0) {
+            taken |= ~((1u << (last % 32)) - 1);
+        }
+        if (taken != 0xFFFFFFFF) {
+            // Isolate the lowest clear bit, and count the zeros above it to find where it is
+            uint32_t free = ~taken & -~taken;
+            int block_num = w * 32 + 31 - __builtin_clz(free);
+            bitmap_set(block_num, true);
+            *hint = w;
+            return block_num;
         }
     }
     return -1;
 }
 
-// Wrapper around free_block specific for data blocks
+// Claim the first available inode block
+int claim_inode_block() {
+    return bitmap_claim(0, INODES, &inode_hint);
+}
+
+// Claim the first available data block
+int claim_data_block() {
+    int block_num = bitmap_claim(INODES, INODES + DATA_BLOCKS, &data_hint);
+    return block_num == -1 ? -1 : block_num - INODES;
+}
+
+// Free a data block in the bitmap
 void free_data_block(int block_num) {
-    free_block(INODES + block_num);
+    bitmap_set(INODES + block_num, false);
 }
 
-// Wrapper around free_block specific for inode blocks
+// Free an inode block in the bitmap, along with its in-core copy
 void free_inode_block(int inode_num) {
-    free_block(inode_num);
+    bitmap_set(inode_num, false);
+    icache_forget(inode_num);
 }
-
@@ -2,18 +2,40 @@
 #define __FILE_H
 
 // Standard includes
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdint.h>
 
-// Disk driver
+// Disk driver, and the cache every filesystem block goes through
 #include "disk.h"
+#include "bcache.h"
 
-// Useful constants
-#define BLOCK_LENGTH (64)
-#define BITMAP_LENGTH (32)
+// Filesystem layout, in blocks of BLOCK_LENGTH bytes (see bcache.h), format.py lays the disk out the same way
+// -- The bitmap comes first, then the inode table and then the data blocks, up to the swap area at sector FS_SECTORS.
+// -- Bits 0 to INODES - 1 of the bitmap are the inodes and data blocks follow them.
+#define FS_SECTORS (16384)
+#define FS_BLOCKS (FS_SECTORS / BLOCK_SECTORS)
 #define INODES (128)
-#define DATA_BLOCKS (16224)
+#define INODE_LENGTH (64)
+#define INODES_PER_BLOCK (BLOCK_LENGTH / INODE_LENGTH)
+#define INODE_BLOCKS (INODES / INODES_PER_BLOCK)
+#define BITMAP_LENGTH ((INODES + FS_BLOCKS + BLOCK_LENGTH * 8 - 1) / (BLOCK_LENGTH * 8))
+#define BITMAP_WORDS (BITMAP_LENGTH * BLOCK_LENGTH / 4)
+#define DATA_START (BITMAP_LENGTH + INODE_BLOCKS)
+#define DATA_BLOCKS (FS_BLOCKS - DATA_START)
+
+// Directory entries packed into the buckets of a directory (see dir.h), a free entry has inode number ENTRY_FREE
+#define DIR_ENTRY_LENGTH (64)
+#define DIR_NAME_LENGTH (56)
+#define DIR_ENTRIES_PER_BLOCK (BLOCK_LENGTH / DIR_ENTRY_LENGTH)
+#define ENTRY_FREE (0xFFFFFFFF)
+
+// Pointers held by an indirect block, and the largest file, which fills the direct, single and double indirect pointers
+// -- With 512 byte blocks this is over 8 MiB, far more than the disk holds.
+#define PTRS_PER_BLOCK (BLOCK_LENGTH / 4)
+#define MAX_FILE_BLOCKS (12 + PTRS_PER_BLOCK + PTRS_PER_BLOCK * PTRS_PER_BLOCK)
+#define MAX_FILE_LENGTH (MAX_FILE_BLOCKS * BLOCK_LENGTH)
 
 // File types
 typedef enum {
@@ -32,30 +54,51 @@ typedef enum {
 typedef struct {
     uint32_t inode_num;
     file_t type;
-    char name[60];
+    char name[DIR_NAME_LENGTH];
 } dir_entry_t;
 
-// Simple inode containing a type and pointers to data
+// Simple inode containing a type, a size in bytes and pointers to its data blocks (a directory's blocks are laid out as in dir.h)
+// -- Blocks past the 12 direct ones are reached through an indirect block of pointers, then a double indirect one.
+// -- Unused pointers are -1, and each inode takes INODE_LENGTH bytes of the inode table.
 typedef struct {
     file_t type;
+    uint32_t size;
     uint32_t directptrs[12];
+    uint32_t indirect;
+    uint32_t double_indirect;
 } inode_t;
 
-// File control block
-typedef struct {
-    int fd;
+struct pipe_t;
+
+// File control block, descriptors point at these and there is no limit on them other than kernel memory
+// -- stream is which standard stream (STDIN, STDOUT, STDERR or CONOUT) the block is, or -1 for a pipe end or a file.
+// -- A pipe end has no inode, refs counts the descriptors (across all processes) that refer to it.
+// -- Each open of a file gets its own control block, so offset is shared only by descriptors duplicated or inherited from it.
+typedef struct fcb_t {
+    int stream;
     int inode_num;
     access_t access;
+    struct pipe_t* pipe;
+    int refs;
+    uint32_t offset;
 } fcb_t;
 
-// Functions for read/write of specific data types to the disk
+// Functions for read/write of specific data types to the disk (inodes go through the in-core inode table)
 void read_inode_block(int inode_num, inode_t* inode);
 void read_data_block(int data_block_num, uint8_t* block);
-void read_dir_entry(int data_block_num, dir_entry_t* dir_entry);
 void write_inode_block(int inode_num, inode_t* inode);
 void write_data_block(int data_block_num, uint8_t* block);
-void write_dir_entry(int data_block_num, dir_entry_t* dir_entry);
-void add_inode_data(inode_t *inode, int inode_num, int ptr, uint8_t* block); 
+
+// Functions for finding, writing and freeing the blocks of a file
+int inode_map(inode_t* inode, uint32_t index, bool alloc);
+int inode_read(inode_t* inode, uint32_t offset, uint8_t* x, uint32_t len);
+int inode_write(inode_t* inode, uint32_t offset, const uint8_t* data, uint32_t len);
+void inode_truncate(inode_t* inode, uint32_t blocks);
+
+// Load the free space bitmaps into memory, and write them (with every other modified block) back to the disk
+// -- Claiming and freeing blocks only changes the bitmaps in memory until the next sync.
+void fs_mount();
+int fs_sync();
 
 // Functions for claiming inode/data blocks
 int claim_inode_block();
@@ -0,0 +1,53 @@
+#include "futex.h"
+
+// Processes waiting on a futex, hashed by the futex's key
+plist_t futex_queues[FUTEX_BUCKETS];
+
+// Clear the wait queues
+void futex_init() {
+    memset(futex_queues, 0, sizeof(futex_queues));
+}
+
+// Get the key identifying the futex at addr
+// -- Shared memory is attached at a different address in each process, so it is keyed by its physical address.
+// -- Everything else (e.g. a global in the program image) is at the same address for every process.
+uint32_t futex_key(uint32_t addr) {
+    if (addr >= VM_BASE && addr < VM_BASE + MAX_PROCS * VM_WINDOW) {
+        uint32_t offset = (addr - VM_BASE) % VM_WINDOW;
+        uint32_t entry = vm_lookup(addr);
+        if (offset >= VM_SHM_OFFSET && offset < VM_SHM_END && (entry & L2_SMALL)) {
+            return (entry & ~(PAGE_SIZE - 1)) | (addr & (PAGE_SIZE - 1));
+        }
+    }
+    return addr;
+}
+
+// Get the wait queue for a key
+plist_t* futex_queue(uint32_t key) {
+    return &futex_queues[(key >> 2) % FUTEX_BUCKETS];
+}
+
+// Queue p on addr if it still holds val, returns 0 if p must block (-1 if the value had changed)
+// -- Nothing can run between the check and the queueing, so a wake cannot be missed.
+int futex_wait(pcb_t* p, uint32_t* addr, uint32_t val) {
+    if (*addr != val) {
+        return -1;
+    }
+    p->futex_key = futex_key((uint32_t) addr);
+    wait_on(futex_queue(p->futex_key), p);
+    return 0;
+}
+
+// Take the longest waiting process off addr's queue (or NULL)
+pcb_t* futex_wake_one(uint32_t* addr) {
+    uint32_t key = futex_key((uint32_t) addr);
+    plist_t* queue = futex_queue(key);
+    for (pnode_t* cur = queue->head; cur != NULL; cur = cur->next) {
+        if (cur->data->futex_key == key) {
+            pcb_t* p = cur->data;
+            stop_waiting(p);
+            return p;
+        }
+    }
+    return NULL;
+}
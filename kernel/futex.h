@@ -0,0 +1,28 @@
+#ifndef __FUTEX_H
+#define __FUTEX_H
+
+// Standard definition includes
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Process definitions and virtual memory
+#include "process.h"
+#include "vm.h"
+
+// Useful constants
+#define FUTEX_BUCKETS (16)
+
+// Futex operations
+#define FUTEX_WAIT (0)
+#define FUTEX_WAKE (1)
+
+// Clear the wait queues
+void futex_init();
+
+// Queue p on addr if it still holds val, returns 0 if p must block (-1 if the value had changed)
+int futex_wait(pcb_t* p, uint32_t* addr, uint32_t val);
+// Take the longest waiting process off addr's queue (or NULL)
+pcb_t* futex_wake_one(uint32_t* addr);
+
+#endif
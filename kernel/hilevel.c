@@ -17,14 +17,12 @@ plist_t* multiq[MAX_PRIORITY + 1];
 // Running process
 pcb_t* running = NULL;
 
-// Global file table
-// -- Consists of FCB entries that keep track of open files across all processes.
-fcb_t file_table[MAX_FILES];
+// Idle process
+// -- Runs only when every other process is blocked, it is never put on the ready queue.
+pcb_t* idle = NULL;
 
-// Next free global file descriptor
-// -- Keeps track of the next available slot in the file_table.
-// -- Initially 4 because there are 4 standard file descriptors for this OS.
-int next_fd = 4;
+// Stack of the idle process, which needs next to nothing
+uint32_t idle_stack[64];
 
 
 /**********************************
@@ -47,13 +45,34 @@ void print_UART(PL011_t* UART, char* str, int len) {
 void make_ready(pcb_t* pcb) {
     // Assign the process a time slice (2^(MAX_PRIORITY - priority_level))
     int temp = 1;
-    for (int i = 0; i < (MAX_PRIORITY - pcb->priority); i++) {
+    for (int i = 0; i < (MAX_PRIORITY - pcb_level(pcb)); i++) {
         temp *= 2;
     }
     pcb->timeslice = temp;
     // Push to the ready queue
     pcb->state = READY;
-    push_list(multiq[pcb->priority], pcb);
+    push_list(multiq[pcb_level(pcb)], pcb);
+}
+
+// Change the level a process inherits through a mutex (-1 for none), moving it between ready queues if needed
+void set_boost(pcb_t* pcb, int boost) {
+    if (pcb->state == READY) {
+        delete_list(multiq[pcb_level(pcb)], pcb->pid);
+        pcb->boost = boost;
+        push_list(multiq[pcb_level(pcb)], pcb);
+    } else {
+        pcb->boost = boost;
+    }
+}
+
+// Check whether a process more urgent than the running one is ready
+bool preempted() {
+    for (int i = MAX_PRIORITY; i > pcb_level(running); i--) {
+        if (!is_empty(multiq[i])) {
+            return true;
+        }
+    }
+    return false;
 }
 
 // Load a process into the process table
@@ -75,9 +94,16 @@ void dispatch(ctx_t* ctx, pcb_t* new) {
     running->state = RUNNING;
 }
 
+// Body of the idle process, waits for the next interrupt
+void idle_loop() {
+    while (1) {
+        asm volatile("wfi");
+    }
+}
+
 // Pick the next process to execute from the ready queue
 void schedule(ctx_t* ctx) {
-    if (running != NULL) {
+    if (running != NULL && running != idle) {
         // If the process used all its time slice then lower priority, otherwise raise it
         if (running->timeslice == 0) {
             running->priority = running->priority - 1 < 0 ? 0 : running->priority - 1;
@@ -95,164 +121,287 @@ void schedule(ctx_t* ctx) {
             return;
         }    
     }
+
+    // Nothing is ready, so idle until the next tick
+    dispatch(ctx, idle);
+    idle->timeslice = 1;
+}
+
+// Block the running process, it stays off the ready queue until something makes it ready again
+void block(ctx_t* ctx) {
+    memcpy(&running->ctx, ctx, sizeof(ctx_t));
+    running->state = WAITING;
+    running = NULL;
+    schedule(ctx);
+}
+
+// Block the running process and hand the CPU straight to a blocked process, without searching the ready queue
+// -- The rest of the time slice goes with it, so a client and server passing a message back and forth share one slice.
+void hand_over(ctx_t* ctx, pcb_t* next) {
+    running->state = WAITING;
+    next->timeslice = running->timeslice > 0 ? running->timeslice : 1;
+    dispatch(ctx, next);
 }
 
 
 /**********************************
- * FILE MANAGEMENT
+ * USER MEMORY
 **********************************/
 
-// Calculate the next free spot in the global file table
-void get_next_global_fd() {
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (file_table[i].fd == -1) {
-            next_fd = i;
-            return;
+// Make sure a page can be touched by the kernel, mapping it in (or swapping it back) just as a fault from the process would
+// -- Only the process windows can fault, everything outside them is always mapped.
+bool user_page(uint32_t va) {
+    if (va < VM_BASE || va >= VM_BASE + MAX_PROCS * VM_WINDOW || (vm_lookup(va) & L2_SMALL)) {
+        return true;
+    }
+    return vm_fault(va, FAULT_TRANSLATION_PAGE) || mmap_fault(va, FAULT_TRANSLATION_PAGE);
+}
+
+// Check a buffer given to a system call before the kernel touches it, so a bad pointer fails the call rather than faulting in the kernel
+// -- e.g. the stack's guard page, heap above the break or an unused part of the window.
+bool user_ok(const void* x, uint32_t len) {
+    uint32_t start = (uint32_t) x;
+    uint32_t end = start + len;
+    if (end < start) {
+        return false;
+    }
+    for (uint32_t va = (start > VM_BASE ? start : VM_BASE) & ~(PAGE_SIZE - 1); va < end && va < VM_BASE + MAX_PROCS * VM_WINDOW; va += PAGE_SIZE) {
+        if (!user_page(va)) {
+            return false;
         }
     }
+    return true;
 }
 
-// Add a relative path to an absolute path
-void calculate_path(char* initial_path, char* added_path) {
-    // Tokenize the additional path
-    char* file = strtok(added_path, "/");
-    while (file != NULL) {
-        // Check for 'goto parent'
-        if (strcmp("..", file) == 0) {
-            // Find the partition to parent directory
-            char* ptr = strrchr(initial_path, '/');
-            // Remove the current directory from the path
-            // Keep the very first '/' to indicate the root directory
-            if (strchr(initial_path, '/') != ptr) {
-                *ptr = '\0';
-            } else {
-                ptr[1] = '\0';
-            }
-        } else {
-            // Add a separator between the parent directory and its child, unless the parent is the root directory
-            if (strcmp(initial_path, "/") != 0) {
-                strcat(initial_path, "/");
-            }
-            strcat(initial_path, file);
+// Check an array of n records of a given size
+bool user_array(const void* x, int n, uint32_t size) {
+    return n <= 0 || ((uint32_t) n <= UINT32_MAX / size && user_ok(x, n * size));
+}
+
+// Check a NUL terminated string, a page at a time as it is scanned
+bool user_str(const char* str) {
+    for (uint32_t va = (uint32_t) str; ; va++) {
+        if ((va == (uint32_t) str || (va & (PAGE_SIZE - 1)) == 0) && !user_page(va & ~(PAGE_SIZE - 1))) {
+            return false;
+        }
+        if (*(char*) va == '\0') {
+            return true;
         }
-        // Move onto the next directory
-        file = strtok(NULL, "/");
     }
-    print_UART(UART0, initial_path, strlen(initial_path));
-    print_UART(UART0, "\n", 1);
 }
 
-// Return the inode for the last directory in the file path
-int traverse_filesystem(char* rel_path, char* file_name, inode_t* dir_inode) {
-    // Calculate the absolute path
-    char* abs_path = malloc(sizeof(char) * MAX_PATH);
-    strcpy(abs_path, running->cwd);
-    calculate_path(abs_path, rel_path);
-
-    // Start our search from '/' (root directory)
-    inode_t inode;
-    int inode_num = 0;
-    read_inode_block(inode_num, &inode);
-    char* file = "";
-    char* next_file = strtok(abs_path, "/");
-    char* next_next_file = strtok(NULL, "/");
-    while (next_file != NULL) {
-        // Look through each entry in the current directory to see if we can find the file
-        if (inode.type == DIRECTORY) {
-            int found = 0;
-            dir_entry_t entry = {0};
-            for (int i = 0; i < 12; i++) {
-                // Check to see if the current entry matches the next part of the path 
-                if (inode.directptrs[i] != -1) {
-                    read_dir_entry(inode.directptrs[i], &entry);
-                    if (strcmp(next_file, entry.name) == 0) {
-                        // Return now if we have reached the last directory
-                        if (entry.type == DATA && next_next_file == NULL) {
-                            strcpy(file_name, entry.name);
-                            free(abs_path);
-                            memcpy(dir_inode, &inode, sizeof(inode_t));
-                            return inode_num;
-                        }
-                        inode_num = entry.inode_num;
-                        found = 1;
-                        break;
-                    }
-                }
-            }
-            // If we haven't found the thing we are looking for, exit the loop
-            if (!found && next_next_file == NULL) {
-                break;
-            }
-            file = next_file;
-            next_file = next_next_file;
-            next_next_file = strtok(NULL, "/");
-            read_inode_block(inode_num, &inode);
-        } else {
-            // Error: trying to traverse through a non-directory
-            inode_num = -1;
-            print_UART(UART1, "bad file path\n", 15);
+
+/**********************************
+ * FILE MANAGEMENT
+**********************************/
+
+// Get the file control block behind one of the running process's descriptors, if it refers to a file on disk (or NULL)
+fcb_t* file_fcb(int usr_fd) {
+    fcb_t* fcb = fd_get(running, usr_fd);
+    return fcb == NULL || fcb->inode_num < 0 ? NULL : fcb;
+}
+
+// Get the directory a path is looked up from, the running process's cwd for AT_FDCWD or else an open directory (or -1)
+int start_dir(int dirfd) {
+    if (dirfd == AT_FDCWD) {
+        return running->cwd;
+    }
+    fcb_t* fcb = file_fcb(dirfd);
+    if (fcb == NULL) {
+        return -1;
+    }
+    return icache_inode(fcb->inode_num)->type == DIRECTORY ? fcb->inode_num : -1;
+}
+
+// Look a path up from directory start, returns the inode number of the last directory on it (or -1)
+// -- The path is read in place a component at a time, and an absolute path starts from the root instead.
+// -- If the path ends in a file, or in a name that does not exist yet, that name is copied to file_name (which holds DIR_NAME_LENGTH bytes).
+// -- Otherwise the path names a directory and file_name is left empty, either way the last directory's inode is read into dir_inode.
+int traverse_filesystem(int start, const char* path, char* file_name, inode_t* dir_inode) {
+    if (!user_str(path)) {
+        return -1;
+    }
+    int inode_num = path[0] == '/' ? 0 : start;
+    if (inode_num == -1) {
+        return -1;
+    }
+    file_name[0] = '\0';
+    const char* p = path;
+    while (true) {
+        while (*p == '/') {
+            p++;
+        }
+        if (*p == '\0') {
             break;
         }
+
+        // Take the next component, cut down to what fits in a directory entry
+        const char* end = p;
+        while (*end != '\0' && *end != '/') {
+            end++;
+        }
+        uint32_t len = end - p < DIR_NAME_LENGTH - 1 ? end - p : DIR_NAME_LENGTH - 1;
+        memcpy(file_name, p, len);
+        file_name[len] = '\0';
+        p = end;
+
+        // Step into a directory, or back out to the parent its header names for .. (the root is its own parent)
+        dir_entry_t entry;
+        if (strcmp(file_name, ".") == 0) {
+            file_name[0] = '\0';
+            continue;
+        }
+        if (strcmp(file_name, "..") == 0) {
+            dir_header_t header;
+            dir_header(icache_inode(inode_num), &header);
+            inode_num = header.parent;
+            file_name[0] = '\0';
+            continue;
+        }
+        if (dcache_lookup(inode_num, file_name, &entry) == 0 && entry.type == DIRECTORY) {
+            inode_num = entry.inode_num;
+            file_name[0] = '\0';
+            continue;
+        }
+
+        // Only the last part of the path can be a file, or a name that does not exist yet
+        while (*p == '/') {
+            p++;
+        }
+        if (*p != '\0') {
+            return -1;
+        }
+        break;
     }
-    // If we get here: either file didn't exist or there wasn't a file at the end of the path
-    if (next_file == NULL) {
-        strcpy(file_name, "");
-    } else {
-        strcpy(file_name, next_file);
-    }
-    memcpy(dir_inode, &inode, sizeof(inode_t));
-    free(abs_path);
+    read_inode_block(inode_num, dir_inode);
     return inode_num;
 }
 
+// Write the path of a directory into a buffer of size bytes, returns its length (or -1 if it does not fit)
+// -- The path is built from the end of the buffer backwards, following each directory's parent up to the root.
+int dir_path(int dir, char* buf, uint32_t size) {
+    if (size < 2) {
+        return -1;
+    }
+    uint32_t pos = size - 1;
+    buf[pos] = '\0';
+    for (int depth = 0; dir != 0 && depth < INODES; depth++) {
+        inode_t inode;
+        dir_header_t header;
+        read_inode_block(dir, &inode);
+        dir_header(&inode, &header);
+        uint32_t len = strlen(header.name);
+        if (len + 1 > pos) {
+            return -1;
+        }
+        pos -= len;
+        memcpy(buf + pos, header.name, len);
+        buf[--pos] = '/';
+        dir = header.parent;
+    }
+    if (pos == size - 1) {
+        buf[--pos] = '/';
+    }
+    memmove(buf, buf + pos, size - pos);
+    return size - 1 - pos;
+}
+
+// Check whether a directory is any process's cwd or is open, so it cannot be removed
+bool dir_busy(int dir) {
+    for (pnode_t* cur = ptable->head; cur != NULL; cur = cur->next) {
+        if (((pcb_t*) cur->data)->cwd == dir) {
+            return true;
+        }
+    }
+    return icache_busy(dir);
+}
+
 
 /**********************************
  * INTERRUPT HANDLING
 **********************************/
 
+// Copy out the usage of the kernel mode stacks and every process's stack, returns how many there are
+int stack_marks(stack_mark_t* marks, int max) {
+    stack_mark_t kernel[3] = {
+        {"irq", -1, (uint32_t) (&tos_irq - &bos_irq) * sizeof(uint32_t), 0},
+        {"svc", -1, (uint32_t) (&tos_svc - &bos_svc) * sizeof(uint32_t), 0},
+        {"abt", -1, (uint32_t) (&tos_abt - &bos_abt) * sizeof(uint32_t), 0}
+    };
+    kernel[0].used = kernel[0].size - stack_unused(&bos_irq, &tos_irq);
+    kernel[1].used = kernel[1].size - stack_unused(&bos_svc, &tos_svc);
+    kernel[2].used = kernel[2].size - stack_unused(&bos_abt, &tos_abt);
+
+    int n = 0;
+    for (int i = 0; i < 3; i++, n++) {
+        if (n < max) {
+            marks[n] = kernel[i];
+        }
+    }
+    for (pnode_t* cur = ptable->head; cur != NULL; cur = cur->next, n++) {
+        if (n < max) {
+            pcb_t* p = cur->data;
+            marks[n] = (stack_mark_t) {p->name, p->pid, VM_STACK_PAGES * PAGE_SIZE - PAGE_SIZE, vm_stack_peak(p->stack_num)};
+        }
+    }
+    return n;
+}
+
 // Hi-level code for handling RST interrupts
 void hilevel_handler_rst(ctx_t* ctx) {
+    // Paint the kernel mode stacks so their deepest use can be reported, leaving the part of this one in use alone
+    uint32_t here;
+    stack_paint(&bos_irq, &tos_irq);
+    stack_paint(&bos_abt, &tos_abt);
+    stack_paint(&bos_svc, &here - 64);
+
     // Setup timer to cause an interupt every 1 second
     TIMER0->Timer1Load = 0x1000;
     TIMER0->Timer1Ctrl = 0xE2;
     
-    // Setup GIC so that timer interrupts are allowed through to the processor via IRQ
+    // Setup GIC so that timer and UART1 (STDIN) interrupts are allowed through to the processor via IRQ
     GICC0->PMR = 0xF0;
     GICC0->CTLR = 0x1;
-    GICD0->ISENABLER1 = 0x10;
+    GICD0->ISENABLER1 = 0x10 | 0x2000;
     GICD0->CTLR = 0x1;
 
-    // Initialise the standard file descriptors: STDIN/STDOUT/STDERR/CONOUT
-    file_table[0] = (fcb_t) {0, -1, READ};
-    file_table[1] = (fcb_t) {1, -1, WRITE}; 
-    file_table[2] = (fcb_t) {2, -1, WRITE}; 
-    file_table[3] = (fcb_t) {3, -1, WRITE}; 
-    for (int i = 4; i < MAX_FILES; i++) {
-        file_table[i] = (fcb_t) {-1, -1, WRITE};
-    }
-    
+    // Set up the kernel memory pool (this also discards anything left over from before a reset)
+    alloc_init();
+
     // Initialise the ready queue
     for (int j = 0; j < MAX_PRIORITY + 1; j++) {
-        if (multiq[j] != NULL) {
-            free_list(multiq[j]);
-        }
         multiq[j] = create_list();
     }
 
     // Initialise process table
-    if (ptable != NULL) {
-        free_list(ptable);
-    }
     ptable = create_list();
 
-    // Set up the stacks for the user process
+    // Set up the block cache, in-core inodes, free space bitmaps, virtual memory, shared memory, file mappings, swap, semaphores, futexes, pipes and the stacks for the user process
+    bcache_init();
+    icache_init();
+    fs_mount();
+    dcache_init();
+    vm_init();
+    shm_init();
+    mmap_init();
+    swap_init();
     init_stacks();
+
+    sem_table_init();
+    futex_init();
+    pipe_init();
+    mutex_table_init();
+    mq_init();
+    poll_init();
     
     // Create the console startup process and change its stdout to conout
     pcb_t* cons = create_PCB("console", (uint32_t) &main_console, NULL);
-    cons->fdtable[1] = 3;
+    cons->fdtable[1] = &std_streams[3];
     load_PCB(cons);
 
+    // Create the idle process, outside the process table and slots
+    idle = create_idle_PCB((uint32_t) &idle_loop, (uint32_t) &idle_stack[64]);
+
     // Schedule the console program
     schedule(ctx);
     
@@ -267,6 +416,9 @@ void hilevel_handler_irq(ctx_t* ctx) {
 
     switch(id) {
         case GIC_SOURCE_TIMER0: {
+            // Wake any process whose timed wait has run out
+            timeout_tick();
+
             // Call scheduler if the time slice has been used
             running->timeslice--;
             if (running->timeslice == 0) {
@@ -275,6 +427,15 @@ void hilevel_handler_irq(ctx_t* ctx) {
 
             // Clear the interrupt from the timer
             TIMER0->Timer1IntClr = 0x1;                        
+            break;
+        }
+        case GIC_SOURCE_UART1: {
+            // Input has arrived on STDIN, so wake anything waiting for it (straight away if nothing else was running)
+            stdin_irq();
+            if (running == idle) {
+                schedule(ctx);
+            }
+            break;
         }
     }
 
@@ -282,6 +443,31 @@ void hilevel_handler_irq(ctx_t* ctx) {
     GICC0->EOIR = id;
 }
 
+// Hi-level code for handling data abort interrupts
+void hilevel_handler_dab(ctx_t* ctx) {
+    // Get the faulting address and the fault status (DFSR[10] joined with DFSR[3:0])
+    uint32_t addr = mmu_get_dfar();
+    uint32_t dfsr = mmu_get_dfsr();
+    uint32_t status = ((dfsr >> 6) & 0x10) | (dfsr & 0xF);
+
+    // Map in the missing page (e.g. grow the stack, or read in part of a mapped file) and retry the access
+    if (vm_fault(addr, status) || mmap_fault(addr, status)) {
+        return;
+    }
+
+    // The kernel itself faulted (pointers from processes are checked before system calls use them), there is nothing sensible left to do
+    if ((ctx->cpsr & 0x1F) != 0x10) {
+        print_UART(UART0, "KERNEL DATA ABORT\n", 18);
+        while (1) {}
+    }
+
+    // Otherwise the process overflowed its stack (or used a bad pointer), so terminate it
+    print_UART(UART0, "SEGMENTATION FAULT\n", 19);
+    destroy_PCB(delete_list(ptable, running->pid));
+    running = NULL;
+    schedule(ctx);
+}
+
 // Hi-level code for handling SVC interrupts
 void hilevel_handler_svc(ctx_t* ctx, uint32_t id) {
     switch(id) {
@@ -297,12 +483,27 @@ void hilevel_handler_svc(ctx_t* ctx, uint32_t id) {
         case SYS_FORK: {
             // Create the new child process as an exact duplicate of its parent
             pcb_t* child = create_PCB(running->name, ctx->pc, running);
+            if (child == NULL) {
+                ctx->gpr[0] = -1;
+                break;
+            }
             memcpy(&child->ctx, ctx, sizeof(ctx_t));
+            if (fd_inherit(child, running) == -1) {
+                destroy_PCB(child);
+                ctx->gpr[0] = -1;
+                break;
+            }
+            child->cwd = running->cwd;
 
-            // Give the child it's own stack, copied from the parent.
+            // Give the child its own stack, local page and heap in its own window, copied from the parent's
+            // -- Frame pointers, and pointers to the parent's stack or heap in registers or in memory, are moved to the child's copies.
             uint32_t stack_offset = running->ptos - ctx->sp;
-            child->ctx.sp -= stack_offset;
-            memcpy((uint32_t*) child->ctx.sp, (uint32_t*) ctx->sp, stack_offset);
+            child->ctx.sp = child->ptos - stack_offset;
+            if (vm_fork(running->stack_num, child->stack_num, ctx->sp, child->ctx.gpr, 13) == -1) {
+                destroy_PCB(child);
+                ctx->gpr[0] = -1;
+                break;
+            }
 
             // Add it to the process table
             load_PCB(child);
@@ -329,7 +530,11 @@ void hilevel_handler_svc(ctx_t* ctx, uint32_t id) {
         case SYS_EXEC: {
             // Overload the process with the new program
             ctx->pc = ctx->gpr[0];
-            // Reset the stack pointer
+            // Reset the stack pointer and heap, giving back the pages used by the old program
+            shm_release(running->stack_num);
+            mmap_release(running->stack_num);
+            vm_stack_release(running->stack_num);
+            vm_heap_release(running->stack_num);
             ctx->sp = running->ptos;
             break;
         }
@@ -355,7 +560,7 @@ void hilevel_handler_svc(ctx_t* ctx, uint32_t id) {
                                 // Remove the PCB for this process from the process table
                                 pcb_t* temp = delete_list(ptable, pid);
                                 // Remove the PCB from the correct ready queue
-                                delete_list(multiq[temp->priority], pid);
+                                delete_list(multiq[pcb_level(temp)], pid);
                                 destroy_PCB(temp);    
                             }
                         }
@@ -363,7 +568,7 @@ void hilevel_handler_svc(ctx_t* ctx, uint32_t id) {
                             // Remove the PCB for this process from the process table
                             pcb_t* temp = delete_list(ptable, pid);
                             // Remove the PCB from the correct ready queue
-                            delete_list(multiq[temp->priority], pid);
+                            delete_list(multiq[pcb_level(temp)], pid);
                             destroy_PCB(temp);
                     }
                     ctx->gpr[0] = 0;
@@ -383,32 +588,118 @@ void hilevel_handler_svc(ctx_t* ctx, uint32_t id) {
                 break;
             }
 
-            // Find the pcb in the process table and change the priority
+            // Find the pcb in the process table and change the priority, moving it to a new ready queue if it is on one
             pcb_t* pcb = search_list(ptable, pid);
-            delete_list(multiq[pcb->priority], pid);
-            pcb->priority = priority;
-            make_ready(pcb);
+            if (pcb->state == READY) {
+                delete_list(multiq[pcb_level(pcb)], pid);
+                pcb->priority = priority;
+                make_ready(pcb);
+            } else {
+                pcb->priority = priority;
+            }
             break; 
         }
 
         case SYS_LIST_PROC: {
-            char** proc_names = malloc(sizeof(char*) * num_procs);
-            int* proc_ids = malloc(sizeof(int*) * num_procs);
-            // Go through the process table and collect the ids and names
-            pnode_t* cur = ptable->head;
-            for (int i = 0; i < num_procs; i++) {
-                proc_names[i] = cur->data->name;
-                proc_ids[i] = cur->data->pid;
-                cur = cur->next;
-            }
-
-            ctx->gpr[0] = (uint32_t) proc_names;
-            ctx->gpr[1] = (uint32_t) proc_ids;
-            ctx->gpr[2] = num_procs;
+            // Fill the given array with the id, name and peak stack usage of up to max processes
+            proc_info_t* procs = (proc_info_t*) ctx->gpr[0];
+            int max = ctx->gpr[1];
+            if (!user_array(procs, max < MAX_PROCS ? max : MAX_PROCS, sizeof(proc_info_t))) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            int n = 0;
+            for (pnode_t* cur = ptable->head; cur != NULL && n < max; cur = cur->next, n++) {
+                procs[n] = (proc_info_t) {cur->data->pid, cur->data->name, vm_stack_peak(cur->data->stack_num)};
+            }
+            ctx->gpr[0] = n;
             break; 
         }
         
 
+        /**********************************
+         * MEMORY MANAGEMENT
+        **********************************/
+
+        case SYS_SBRK: {
+            // Move the heap break by the given amount, returning the old break (or -1 on failure)
+            uint32_t old = vm_sbrk(running->stack_num, (int) ctx->gpr[0]);
+            ctx->gpr[0] = old == 0 ? -1 : old;
+            break;
+        }
+
+        case SYS_SHM_CREATE: {
+            // Create a shared memory segment of the given size, returning its id
+            ctx->gpr[0] = shm_create(running->stack_num, ctx->gpr[0]);
+            break;
+        }
+
+        case SYS_SHM_ATTACH: {
+            // Map the segment with the given id into the process, returning its address
+            ctx->gpr[0] = shm_attach(running->stack_num, (int) ctx->gpr[0]);
+            break;
+        }
+
+        case SYS_SHM_DETACH: {
+            // Unmap the segment attached at the given address
+            ctx->gpr[0] = shm_detach(running->stack_num, ctx->gpr[0]);
+            break;
+        }
+
+        case SYS_MMAP: {
+            // Map the first len bytes of an open file into the process window
+            fcb_t* fcb = file_fcb(ctx->gpr[0]);
+            uint32_t len = ctx->gpr[1];
+            if (fcb == NULL) {
+                ctx->gpr[0] = 0;
+            } else {
+                ctx->gpr[0] = mmap_file(running->stack_num, fcb->inode_num, len);
+            }
+            break;
+        }
+
+        case SYS_MUNMAP: {
+            // Write back and unmap the file mapped at the given address
+            ctx->gpr[0] = mmap_unmap(running->stack_num, ctx->gpr[0]);
+            break;
+        }
+
+        case SYS_MSYNC: {
+            // Write back the dirty pages of the file mapped at the given address
+            ctx->gpr[0] = mmap_sync(running->stack_num, ctx->gpr[0]);
+            break;
+        }
+
+        case SYS_MEM_STATS: {
+            // Copy out up to max records of the requested kind, returning how many there are
+            void* buf = (void*) ctx->gpr[1];
+            int max = ctx->gpr[2];
+            uint32_t size = ctx->gpr[0] == MEM_SITES ? sizeof(kmem_site_t) : ctx->gpr[0] == MEM_CACHES ? sizeof(kmem_cache_stat_t) : sizeof(stack_mark_t);
+            if (!user_array(buf, max, size)) {
+                ctx->gpr[0] = -1;
+            } else if (ctx->gpr[0] == MEM_SITES) {
+                ctx->gpr[0] = kmem_site_stats(buf, max);
+            } else if (ctx->gpr[0] == MEM_CACHES) {
+                ctx->gpr[0] = cache_stats(buf, max);
+            } else if (ctx->gpr[0] == MEM_STACKS) {
+                ctx->gpr[0] = stack_marks(buf, max);
+            } else {
+                ctx->gpr[0] = -1;
+            }
+            break;
+        }
+
+        case SYS_SWAP_STATS: {
+            // Copy the swap counters out to the given structure
+            if (!user_ok((void*) ctx->gpr[0], sizeof(swap_stat_t))) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            swap_get_stats((swap_stat_t*) ctx->gpr[0]);
+            break;
+        }
+
+
         /**********************************
          * FILE MANAGEMENT
         **********************************/
@@ -419,44 +710,53 @@ void hilevel_handler_svc(ctx_t* ctx, uint32_t id) {
             char* str = (char*) ctx->gpr[1];
             uint32_t len = ctx->gpr[2];
             
-            // Calculate the correct file descriptor from the process file table
-            int fd = running->fdtable[usr_fd];
+            // Find the file control block behind the descriptor in the process's table
+            fcb_t* fcb = fd_get(running, usr_fd);
+            if (fcb == NULL || !user_ok(str, len)) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+
+            // Write to a pipe's write end, blocking (and restarting the call once woken) while it is full
+            if (fcb->pipe != NULL) {
+                pipe_t* pipe = fcb->pipe;
+                if (fcb->access == READ || pipe->readers == 0) {
+                    ctx->gpr[0] = -1;
+                } else if (len == 0) {
+                    ctx->gpr[0] = 0;
+                } else {
+                    uint32_t n = pipe_write(pipe, (uint8_t*) str, len);
+                    if (n == 0) {
+                        ctx->pc -= 4;
+                        wait_on(&pipe->write_waiters, running);
+                        block(ctx);
+                        break;
+                    }
+                    wake_all(&pipe->read_waiters);
+                    ctx->gpr[0] = n;
+                }
+                break;
+            }
 
             // Print to correct screen for STDOUT/STDERR/CONOUT
-            if (fd == 1 || fd == 2) { 
+            if (fcb->stream == 1 || fcb->stream == 2) { 
                 print_UART(UART0, str, len);
-            } else if (fd == 3) {
+            } else if (fcb->stream == 3) {
                 print_UART(UART1, str, len);
             } else {
-                // Get the corresponding inode from the file descriptor
-                inode_t inode;
-                int inode_num = file_table[fd].inode_num;
-                read_inode_block(inode_num, &inode);
-
-                // Calculate the number of data blocks required for the data
-                uint8_t block[BLOCK_LENGTH] = {0};
-                int full = len / BLOCK_LENGTH;
-                int rem =len % BLOCK_LENGTH;
-
-                // Check if the data is too big for the file
-                if (full > 11 || (full == 12 && rem != 0)) {
-                    print_UART(UART0, "DATA TOO LARGE\n", 15);
-                    ctx->gpr[0] = 0;
-                    return;
-                }
-
-                // Write the full blocks of data first
-                for (int i = 0; i < full; i++) {
-                    memcpy(block, str, BLOCK_LENGTH);
-                    str += BLOCK_LENGTH;
-                    add_inode_data(&inode, inode_num, i, block);
-                }
-                // Then write the non-full block (if it exists)
-                if (rem != 0) {
-                    uint8_t block[BLOCK_LENGTH] = {0};
-                    memcpy(block, str, rem);
-                    add_inode_data(&inode, inode_num, full, block);
+                // Write at the file's offset (or its end when opened for appending) and move the offset past what was written
+                // -- The inode is changed in place in the in-core table, it is only written back at the next sync.
+                if (fcb->access == READ) {
+                    ctx->gpr[0] = -1;
+                    break;
                 }
+                inode_t* inode = icache_inode(fcb->inode_num);
+                uint32_t offset = fcb->access == APPEND ? inode->size : fcb->offset;
+                int n = inode_write(inode, offset, (const uint8_t*) str, len);
+                icache_dirty(fcb->inode_num);
+                fcb->offset = offset + n;
+                ctx->gpr[0] = n;
+                break;
             }
             
             // Return the number of bytes written to file
@@ -470,251 +770,322 @@ void hilevel_handler_svc(ctx_t* ctx, uint32_t id) {
             char* str = (char*) ctx->gpr[1];
             uint32_t len = ctx->gpr[2];
 
-            // Calculate the correct file descriptor from the process file table
-            int fd = running->fdtable[usr_fd];
+            // Find the file control block behind the descriptor in the process's table
+            fcb_t* fcb = fd_get(running, usr_fd);
+            if (fcb == NULL || !user_ok(str, len)) {
+                ctx->gpr[0] = -1;
+                break;
+            }
 
-            // Handle STDIN
-            if (fd == 0) {
-                for (int i = 0; i < len; i++) {
-                    str[i] = PL011_getc(UART1, true);
+            // Read from a pipe's read end, blocking (and restarting the call once woken) while it is empty and still has writers
+            if (fcb->pipe != NULL) {
+                if (fcb->access != READ) {
+                    ctx->gpr[0] = -1;
+                    break;
                 }
-            } else {
-                // Get the corresponding inode from the file descriptor
-                inode_t inode;
-                int inode_num = file_table[fd].inode_num;
-                read_inode_block(inode_num, &inode);
-                
-                // Calculate the number of data blocks required for the data
-                uint8_t block[BLOCK_LENGTH] = {0};
-                int full = len / BLOCK_LENGTH;
-                int rem = len % BLOCK_LENGTH;
-
-                // Check if the data is too big for the file
-                if (full > 11 || (full == 12 && rem != 0)) {
-                    print_UART(UART0, "DATA TOO LARGE\n", 15);
-                    ctx->gpr[0] = 0;
-                    return;
+                pipe_t* pipe = fcb->pipe;
+                uint32_t n = pipe_read(pipe, (uint8_t*) str, len);
+                if (n == 0 && len != 0 && pipe->writers > 0) {
+                    ctx->pc -= 4;
+                    wait_on(&pipe->read_waiters, running);
+                    block(ctx);
+                    break;
                 }
+                wake_all(&pipe->write_waiters);
+                ctx->gpr[0] = n;
+                break;
+            }
 
-                // Read the full blocks of data first
-                for (int i = 0; i < full; i++) {
-                    read_data_block(inode.directptrs[i], block);
-                    memcpy(&str[i * BLOCK_LENGTH], block, BLOCK_LENGTH);
+            // Handle STDIN, taking whatever input has arrived and blocking (restarting the call once woken) while there is none
+            if (fcb->stream == 0) {
+                if (len != 0 && !PL011_can_getc(UART1)) {
+                    ctx->pc -= 4;
+                    stdin_wait(running);
+                    block(ctx);
+                    break;
                 }
-                // Then read the non-full block (if it exists)
-                if (rem != 0) {
-                    uint8_t block[BLOCK_LENGTH] = {0};
-                    read_data_block(inode.directptrs[full], block);
-                    memcpy(str, block, rem);
+                uint32_t n = 0;
+                while (n < len && PL011_can_getc(UART1)) {
+                    str[n++] = PL011_getc(UART1, false);
                 }
+                ctx->gpr[0] = n;
+                break;
+            } else if (fcb->stream != -1) {
+                // The output streams cannot be read from
+                ctx->gpr[0] = -1;
+            } else {
+                // Read from the file's offset, stopping at the end of the file, and move the offset past what was read
+                int n = inode_read(icache_inode(fcb->inode_num), fcb->offset, (uint8_t*) str, len);
+                fcb->offset += n;
+                ctx->gpr[0] = n;
             }
-            
-            // Return the number of bytes written to file
-            ctx->gpr[0] = len;
+            break;
+        }
+
+        case SYS_LSEEK: {
+            // Move a file's offset relative to the start, the current offset or the end, returning the new offset (or -1)
+            // -- Seeking past the end is allowed, a later write there leaves a hole that reads as zeroes.
+            fcb_t* fcb = file_fcb(ctx->gpr[0]);
+            int offset = (int) ctx->gpr[1];
+            int whence = (int) ctx->gpr[2];
+            if (fcb == NULL) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            int base;
+            if (whence == SEEK_SET) {
+                base = 0;
+            } else if (whence == SEEK_CUR) {
+                base = fcb->offset;
+            } else if (whence == SEEK_END) {
+                base = icache_inode(fcb->inode_num)->size;
+            } else {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            if (base + offset < 0 || base + offset > MAX_FILE_LENGTH) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            fcb->offset = base + offset;
+            ctx->gpr[0] = fcb->offset;
+            break;
+        }
+
+        case SYS_PREAD: {
+            // Read from a given offset without moving the file's offset
+            fcb_t* fcb = file_fcb(ctx->gpr[0]);
+            if (fcb == NULL || !user_ok((void*) ctx->gpr[1], ctx->gpr[2])) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            ctx->gpr[0] = inode_read(icache_inode(fcb->inode_num), ctx->gpr[3], (uint8_t*) ctx->gpr[1], ctx->gpr[2]);
+            break;
+        }
+
+        case SYS_PWRITE: {
+            // Write at a given offset without moving the file's offset, even if it was opened for appending
+            fcb_t* fcb = file_fcb(ctx->gpr[0]);
+            if (fcb == NULL || fcb->access == READ || !user_ok((void*) ctx->gpr[1], ctx->gpr[2])) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            ctx->gpr[0] = inode_write(icache_inode(fcb->inode_num), ctx->gpr[3], (const uint8_t*) ctx->gpr[1], ctx->gpr[2]);
+            icache_dirty(fcb->inode_num);
             break;
         }
 
         case SYS_OPEN: {
-            // Calculate the absolute path to the new directory
-            char* rel_path = (char*) ctx->gpr[0];
-            char file_name[60];
+            // Find the file's directory, looking the path up from the directory descriptor given (or the cwd)
+            char* rel_path = (char*) ctx->gpr[1];
+            access_t access = ctx->gpr[2] <= APPEND ? ctx->gpr[2] : WRITE;
+            char file_name[DIR_NAME_LENGTH];
             inode_t dir_inode = {0};
-            int dir_inode_num = traverse_filesystem(rel_path, file_name, &dir_inode);
+            int dir_inode_num = traverse_filesystem(start_dir(ctx->gpr[0]), rel_path, file_name, &dir_inode);
+            ctx->gpr[0] = -1;
             if (dir_inode_num == -1) break; 
-            if (strcmp(file_name, "") == 0) {
-                print_UART(UART1, "Cannot access a directory\n", 26);
-            }
 
-            // Look through each entry in the directory to see if we can find the file
+            // A directory can only be opened for reading, as somewhere to look paths up from
             dir_entry_t entry = {0};
-            int free_entry_num = -1;
             int inode_num = -1;
-            for (int i = 0; i < 12; i++) {
-                // Keep track of the first free location, in case we need to add a new entry
-                if (dir_inode.directptrs[i] == -1) {
-                    free_entry_num = free_entry_num == -1 ? i : free_entry_num;
-                } else {
-                    read_dir_entry(dir_inode.directptrs[i], &entry);
-                    if (strcmp(file_name, entry.name) == 0) {
-                        inode_num = i;
-                        break;
-                    }
+            if (strcmp(file_name, "") == 0) {
+                if (access != READ) {
+                    print_UART(UART1, "Cannot access a directory\n", 26);
+                    break;
                 }
+                inode_num = dir_inode_num;
+            } else if (dcache_lookup(dir_inode_num, file_name, &entry) == 0) {
+                inode_num = entry.inode_num;
             }
 
             // If we didn't find the file then create it 
             if (inode_num == -1) {
-                if (free_entry_num == -1) {
+                inode_num = claim_inode_block();
+                if (inode_num == -1) {
+                    ctx->gpr[0] = -1;
+                    break;
+                }
+                // Add a new entry to the directory
+                entry = (dir_entry_t) {inode_num, DATA};
+                strncpy(entry.name, file_name, DIR_NAME_LENGTH - 1);
+                if (dir_add(&dir_inode, &entry) == -1) {
+                    free_inode_block(inode_num);
+                    write_inode_block(dir_inode_num, &dir_inode);
                     print_UART(UART1, "Directory full\n", 15);
+                    ctx->gpr[0] = -1;
                     break;
                 }
-                // Create a new directory entry
-                entry.inode_num = claim_inode_block();
-                inode_num = entry.inode_num;
-                entry.type = DATA;
-                strcpy(entry.name, file_name);
-                
-                // Write this entry into the directory inode
-                dir_inode.directptrs[free_entry_num] = claim_data_block();
-                write_dir_entry(dir_inode.directptrs[free_entry_num], &entry);
                 write_inode_block(dir_inode_num, &dir_inode);
+                dcache_forget(dir_inode_num, file_name);
                 
                 // Create a new inode for this file
                 inode_t new_inode;
                 for (int i = 0; i < 12; i++) {
                     new_inode.directptrs[i] = -1;
                 }
+                new_inode.indirect = -1;
+                new_inode.double_indirect = -1;
+                new_inode.size = 0;
                 new_inode.type = DATA;
                 write_inode_block(entry.inode_num, &new_inode);
             }
-            // Check if file already open
-            for (int i = 0; i < MAX_FILES; i++) {
-                // Check if the file is in the process file table already
-                if (file_table[running->fdtable[i]].inode_num == i) {
-                    ctx->gpr[0] = i;
-                    return;
-                }
-                // Check if the file is in the global file table already
-                if (file_table[i].inode_num == inode_num) {
-                    running->fdtable[running->next_fd] = file_table[i].fd;
-                    ctx->gpr[0] = running->next_fd;
-                    get_next_fd(running);
-                    return;
-                }
+            // Every open gets its own open file, with its own offset starting at the beginning of the file
+            // -- The open file holds the in-core inode until it is closed, so reads and writes never go back to the inode block.
+            fcb_t* new = cache_alloc(file_cache);
+            if (new == NULL) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            *new = (fcb_t) {-1, inode_num, access, NULL, 1, 0};
+            int fd = fd_alloc(running, new);
+            if (fd == -1) {
+                cache_free(file_cache, new);
+                ctx->gpr[0] = -1;
+                break;
             }
-            // Otherwise create new open file descriptor
-            fcb_t new = (fcb_t) {next_fd, inode_num, WRITE};
-            file_table[new.fd] = new;
-            running->fdtable[running->next_fd] = new.fd;
-            ctx->gpr[0] = running->next_fd;
-            get_next_fd(running);
-            get_next_global_fd();
+            icache_get(inode_num);
+            ctx->gpr[0] = fd;
             break;
         }
        
         case SYS_CLOSE: {
             // Get the file descriptor for the process 
             int usr_fd = (int) ctx->gpr[0];
-            running->fdtable[usr_fd] = -1;
+            fd_close(running, usr_fd);
+            break;
+        }
+
+        case SYS_PIPE: {
+            // Create a pipe and give the caller a read end and a write end, in the given array
+            int* fds = (int*) ctx->gpr[0];
+            if (!user_ok(fds, 2 * sizeof(int))) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            pipe_t* pipe = pipe_create();
+            if (pipe == NULL) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            fds[0] = fds[1] = -1;
+            for (int end = 0; end < 2; end++) {
+                // Both ends need a control block and a descriptor
+                fcb_t* fcb = cache_alloc(file_cache);
+                if (fcb == NULL) {
+                    break;
+                }
+                *fcb = (fcb_t) {-1, -1, end == 0 ? READ : WRITE, pipe, 1};
+                fds[end] = fd_alloc(running, fcb);
+                if (fds[end] == -1) {
+                    cache_free(file_cache, fcb);
+                    break;
+                }
+                if (end == 0) {
+                    pipe->readers++;
+                } else {
+                    pipe->writers++;
+                }
+            }
+
+            // Undo a half made pipe (closing the read end frees the pipe once it has no ends)
+            if (fds[1] == -1) {
+                if (fds[0] != -1) {
+                    fd_close(running, fds[0]);
+                } else {
+                    cache_free(pipe_cache, pipe);
+                }
+                ctx->gpr[0] = -1;
+                break;
+            }
+            ctx->gpr[0] = 0;
+            break;
+        }
+
+        case SYS_DUP2: {
+            // Make the second descriptor refer to the same file as the first
+            ctx->gpr[0] = fd_dup2(running, ctx->gpr[0], ctx->gpr[1]);
             break;
         }
 
         case SYS_REMOVE: {
-            char* rel_path = (char*) ctx->gpr[0];
-            char file_name[60];
+            char* rel_path = (char*) ctx->gpr[1];
+            char file_name[DIR_NAME_LENGTH];
             inode_t dir_inode;
-            int dir_inode_num = traverse_filesystem(rel_path, file_name, &dir_inode);
+            int dir_inode_num = traverse_filesystem(start_dir(ctx->gpr[0]), rel_path, file_name, &dir_inode);
+            ctx->gpr[0] = -1;
             if (dir_inode_num == -1) break;
             if (strcmp(file_name, "") == 0) {
                 print_UART(UART1, "Trying to remove a directory\n", 29);
+                break;
             }
 
             // Look for file in the directory
             dir_entry_t entry = {0};
-            int dir_entry_num = -1;
-            for (int i = 0; i < 12; i++) {
-                if (dir_inode.directptrs[i] != -1) {
-                    read_dir_entry(dir_inode.directptrs[i], &entry);
-                    if (strcmp(file_name, entry.name) == 0) { 
-                        dir_entry_num = i;
-                        break;
-                    }
-                }
-            }
-
-            if (dir_entry_num == -1) {
+            if (dcache_lookup(dir_inode_num, file_name, &entry) == -1) {
                 print_UART(UART1, "File not found\n", 15);
                 break;
             }
 
-            // Deallocate all the space used by the file in memory
-            inode_t file_inode = {0};
-            read_inode_block(entry.inode_num, &file_inode);
-            // Free data blocks
-            for (int i = 0; i < 12; i++) {
-                if (file_inode.directptrs[i] != -1) {
-                    free_data_block(file_inode.directptrs[i]);
-                }
-            }
             // Free the directory entry
-            free_data_block(dir_inode.directptrs[dir_entry_num]);
-            dir_inode.directptrs[dir_entry_num] = -1;
-            write_inode_block(dir_inode_num, &dir_inode);
-
-            // Free the inode
-            free_inode_block(entry.inode_num);
-
-            // Remove the file from any file tables
-            for (int i = 0; i < MAX_FILES; i++) {
-                // Check if the file is in the process file table 
-                if (file_table[running->fdtable[i]].inode_num == entry.inode_num) {
-                    running->fdtable[i] = -1;
-                    file_table[running->fdtable[i]].fd = -1;
-                    file_table[running->fdtable[i]].inode_num = -1;
-                    break;
-                }
-                // Check if the file is in the global file table 
-                if (file_table[i].inode_num == entry.inode_num) {
-                    file_table[i].fd = -1;
-                    file_table[i].inode_num = -1;
-                    break;
-                }
-            }
+            dir_remove(&dir_inode, file_name);
+            dcache_forget(dir_inode_num, file_name);
+
+            // Free the inode and its blocks, or leave that to the last close if the file is still open (or mapped) somewhere
+            icache_unlink(entry.inode_num);
+            ctx->gpr[0] = 0;
             break;
         }
 
         case SYS_MKDIR: {
-            char* rel_path = (char*) ctx->gpr[0];
-            char dir_name[60];
+            char* rel_path = (char*) ctx->gpr[1];
+            char dir_name[DIR_NAME_LENGTH];
             inode_t parent_inode = {0};
-            int parent_inode_num = traverse_filesystem(rel_path, dir_name, &parent_inode);
+            int parent_inode_num = traverse_filesystem(start_dir(ctx->gpr[0]), rel_path, dir_name, &parent_inode);
+            ctx->gpr[0] = -1;
             // Check for errors
             if (parent_inode_num == -1) break;
             // Make sure we have a name for this new directory
             if (strcmp(dir_name, "") == 0) {
                 print_UART(UART1, "Bad file path\n", 15);
+                break;
+            }
+            dir_entry_t dir = {0};
+            if (dir_lookup(&parent_inode, dir_name, &dir) == 0) {
+                print_UART(UART1, "File exists\n", 12);
+                break;
             }
 
-            dir_entry_t entry = {0};
-            int created = 0;
-            for (int i = 0; i < 12; i++) {
-                // If we find a space for the new directory, create a new directory
-                if (parent_inode.directptrs[i] == -1) {
-                    // Create a new directory entry
-                    dir_entry_t dir = {0};
-                    dir.inode_num = claim_inode_block();
-                    dir.type = DIRECTORY;
-                    strcpy(dir.name, dir_name);
-
-                    // Write this entry into the directory inode
-                    parent_inode.directptrs[i] = claim_data_block();
-                    write_dir_entry(parent_inode.directptrs[i], &dir);
-                    write_inode_block(parent_inode_num, &parent_inode);
-                    
-                    // Create a new inode for this directory
-                    inode_t new_inode;
-                    new_inode.directptrs[0] = parent_inode.directptrs[i]; // . entry
-                    new_inode.directptrs[1] = parent_inode.directptrs[0]; // .. entry
-                    for (int i = 2; i < 12; i++) {
-                        new_inode.directptrs[i] = -1;
-                    }
-                    new_inode.type = DIRECTORY;
-                    write_inode_block(dir.inode_num, &new_inode);
-                    created = 1;
-                    break;
-                }
+            // Create a new directory entry
+            int inode_num = claim_inode_block();
+            if (inode_num == -1) {
+                print_UART(UART1, "Out of inodes\n", 14);
+                break;
             }
-            if (!created) {
+            dir = (dir_entry_t) {inode_num, DIRECTORY};
+            strncpy(dir.name, dir_name, DIR_NAME_LENGTH - 1);
+
+            // Lay out the new directory, remembering its parent and name, and add it to the parent
+            inode_t new_inode;
+            if (dir_create(&new_inode, parent_inode_num, dir.name) == -1 || dir_add(&parent_inode, &dir) == -1) {
+                inode_truncate(&new_inode, 0);
+                free_inode_block(inode_num);
+                write_inode_block(parent_inode_num, &parent_inode);
                 print_UART(UART1, "Directory full\n", 15);
+                break;
             }
+            write_inode_block(inode_num, &new_inode);
+            write_inode_block(parent_inode_num, &parent_inode);
+            dcache_forget(parent_inode_num, dir.name);
+            ctx->gpr[0] = 0;
             break;
         }
 
         case SYS_RMDIR: {
-            char* rel_path = (char*) ctx->gpr[0];
-            char last_data[60];
+            char* rel_path = (char*) ctx->gpr[1];
+            char last_data[DIR_NAME_LENGTH];
             inode_t dir_inode = {0};
-            int dir_inode_num = traverse_filesystem(rel_path, last_data, &dir_inode);
+            int dir_inode_num = traverse_filesystem(start_dir(ctx->gpr[0]), rel_path, last_data, &dir_inode);
+            ctx->gpr[0] = -1;
             // Check if we had errors
             if (dir_inode_num == -1) break;
             // There should be no data at the end of the path
@@ -723,35 +1094,41 @@ void hilevel_handler_svc(ctx_t* ctx, uint32_t id) {
                 break;
             }    
 
-            // Free the directory entry
-            dir_entry_t this_dir;
-            read_dir_entry(dir_inode.directptrs[0], &this_dir);
-            dir_entry_t parent_dir;
-            read_dir_entry(dir_inode.directptrs[1], &parent_dir);
-            inode_t parent_inode;
-            read_inode_block(parent_dir.inode_num, &parent_inode);
-
-            dir_entry_t entry = {0};
-            for (int i = 0; i < 12; i++) {
-                if (parent_inode.directptrs[i] != -1) {
-                    read_dir_entry(parent_inode.directptrs[i], &entry);
-                    if (strcmp(this_dir.name, entry.name) == 0) { 
-                        free_data_block(parent_inode.directptrs[i]);
-                        parent_inode.directptrs[i] = -1;
-                        write_inode_block(parent_dir.inode_num, &parent_inode);
-                        break;
-                    }
-                }
+            // Only an empty directory other than the root can go
+            dir_header_t header;
+            dir_header(&dir_inode, &header);
+            if (dir_inode_num == 0) {
+                print_UART(UART1, "Cannot remove the root directory\n", 33);
+                break;
             }
+            if (header.entries != 0) {
+                print_UART(UART1, "Directory not empty\n", 20);
+                break;
+            }
+            if (dir_busy(dir_inode_num)) {
+                print_UART(UART1, "Directory in use\n", 17);
+                break;
+            }
+
+            // Free the entry in the parent (its header says which and under what name), then the directory's blocks and inode
+            inode_t parent_inode;
+            read_inode_block(header.parent, &parent_inode);
+            dir_remove(&parent_inode, header.name);
+            dcache_forget(header.parent, header.name);
+            dcache_forget_dir(dir_inode_num);
+            inode_truncate(&dir_inode, 0);
             free_inode_block(dir_inode_num);
+            ctx->gpr[0] = 0;
             break;
         }
 
         case SYS_CHDIR: {
-            char* rel_path = (char*) ctx->gpr[0];
-            char last_data[60];
+            // Move the cwd to the directory the path names, which is remembered by its inode rather than its path
+            char* rel_path = (char*) ctx->gpr[1];
+            char last_data[DIR_NAME_LENGTH];
             inode_t dir_inode = {0};
-            int dir_inode_num = traverse_filesystem(rel_path, last_data, &dir_inode);
+            int dir_inode_num = traverse_filesystem(start_dir(ctx->gpr[0]), rel_path, last_data, &dir_inode);
+            ctx->gpr[0] = -1;
             // Check for errors
             if (dir_inode_num == -1) break; 
             // Make sure there is a correct file path
@@ -759,40 +1136,34 @@ void hilevel_handler_svc(ctx_t* ctx, uint32_t id) {
                 print_UART(UART1, "Bad file path\n", 15);
                 break;
             }    
-            calculate_path(running->cwd, rel_path);
-            print_UART(UART0, running->cwd, strlen(running->cwd));
+            running->cwd = dir_inode_num;
+            ctx->gpr[0] = 0;
             break;
         }
 
         case SYS_GETCWD: {
-            ctx->gpr[0] = (uint32_t) running->cwd;
+            // Write the cwd's path into the buffer given, returning its length (or -1 if it does not fit)
+            ctx->gpr[0] = user_ok((char*) ctx->gpr[0], ctx->gpr[1]) ? dir_path(running->cwd, (char*) ctx->gpr[0], ctx->gpr[1]) : -1;
             break;
         }
 
         case SYS_LISTDIR: {
-            char* rel_path = (char*) ctx->gpr[0];
-            char dir_name[60];
+            char* rel_path = (char*) ctx->gpr[1];
+            char dir_name[DIR_NAME_LENGTH];
             inode_t dir_inode = {0};
-            int dir_inode_num = traverse_filesystem(rel_path, dir_name, &dir_inode);
+            int dir_inode_num = traverse_filesystem(start_dir(ctx->gpr[0]), rel_path, dir_name, &dir_inode);
             if (dir_inode_num == -1) break; 
             if (strcmp(dir_name, "") != 0) {
                 print_UART(UART1, "Bad file path\n", 15);
                 break;
             }    
+            // Print . and .., then every entry in the directory (in hash order)
+            print_UART(UART1, ".\n..\n", 5);
             dir_entry_t entry = {0};
-            // Print all non-empty directory entries
-            for (int i = 0; i < 12; i++) {
-                if (i == 0) {
-                    print_UART(UART1, ".", 1);
-                    print_UART(UART1, "\n", 1);
-                } else if (i == 1) {
-                    print_UART(UART1, "..", 2);
-                    print_UART(UART1, "\n", 1);
-                } else if (dir_inode.directptrs[i] != -1) {
-                    read_dir_entry(dir_inode.directptrs[i], &entry);
-                    print_UART(UART1, entry.name, strlen(entry.name));
-                    print_UART(UART1, "\n", 1);
-                }
+            uint32_t pos = 0;
+            while (dir_next(&dir_inode, &pos, &entry) == 0) {
+                print_UART(UART1, entry.name, strlen(entry.name));
+                print_UART(UART1, "\n", 1);
             }
             break;
         }
@@ -804,17 +1175,282 @@ void hilevel_handler_svc(ctx_t* ctx, uint32_t id) {
 
         // Handle the sem_init system call
         case SYS_SEM_INIT: {
-            // Create a semaphore
-            uint32_t* sem = malloc(sizeof(uint32_t));
-            // Initialise the value
-            *sem = ctx->gpr[0];
-            ctx->gpr[0] = (uint32_t) sem;
+            // Create a semaphore in the kernel table with the given value, returning its id
+            ctx->gpr[0] = sem_create(ctx->gpr[0]);
             break;           
         }
 
         // Handle the sem_close system call
         case SYS_SEM_CLOSE: {
-            free((uint32_t*) ctx->gpr[0]);
+            ctx->gpr[0] = sem_destroy(ctx->gpr[0]);
+            break;
+        }
+
+        // Handle the sem_wait system call
+        case SYS_SEM_WAIT: {
+            // Take a unit, or block on the semaphore's queue until a post hands one over
+            int r = sem_take(ctx->gpr[0], running);
+            ctx->gpr[0] = r == -1 ? -1 : 0;
+            if (r == 0) {
+                block(ctx);
+            }
+            break;
+        }
+
+        // Handle the sem_post system call
+        case SYS_SEM_POST: {
+            // Give a unit back, waking the oldest waiter if there is one
+            pcb_t* waiter = sem_give(ctx->gpr[0]);
+            if (waiter != NULL) {
+                make_ready(waiter);
+            }
+            ctx->gpr[0] = 0;
+            break;
+        }
+
+        // Handle the futex system call
+        case SYS_FUTEX: {
+            uint32_t* addr = (uint32_t*) ctx->gpr[0];
+            uint32_t op = ctx->gpr[1];
+            uint32_t val = ctx->gpr[2];
+            if (addr == NULL || ((uint32_t) addr & 0x3) != 0 || !user_ok(addr, sizeof(uint32_t))) {
+                ctx->gpr[0] = -1;
+            } else if (op == FUTEX_WAIT) {
+                // Sleep until woken, unless the word no longer holds the value the caller saw
+                int r = futex_wait(running, addr, val);
+                ctx->gpr[0] = r;
+                if (r == 0) {
+                    block(ctx);
+                }
+            } else if (op == FUTEX_WAKE) {
+                // Wake up to val waiters, returning how many there were
+                int woken = 0;
+                pcb_t* waiter;
+                while (woken < val && (waiter = futex_wake_one(addr)) != NULL) {
+                    make_ready(waiter);
+                    woken++;
+                }
+                ctx->gpr[0] = woken;
+            } else {
+                ctx->gpr[0] = -1;
+            }
+            break;
+        }
+
+        case SYS_KMUTEX_INIT: {
+            // Create a priority inheriting mutex in the kernel table, returning its id
+            ctx->gpr[0] = kmutex_create();
+            break;
+        }
+
+        case SYS_KMUTEX_CLOSE: {
+            ctx->gpr[0] = kmutex_destroy(ctx->gpr[0]);
+            break;
+        }
+
+        case SYS_KMUTEX_LOCK: {
+            // Take the mutex, or block on it (lending the owner our level) until an unlock hands it over
+            int r = kmutex_take(ctx->gpr[0], running);
+            ctx->gpr[0] = r == -1 ? -1 : 0;
+            if (r == 0) {
+                block(ctx);
+            }
+            break;
+        }
+
+        case SYS_KMUTEX_UNLOCK: {
+            // Hand the mutex on, and give way straight away if that woke a more urgent process
+            ctx->gpr[0] = kmutex_give(ctx->gpr[0], running);
+            if (preempted()) {
+                schedule(ctx);
+            }
+            break;
+        }
+
+        case SYS_COND_INIT: {
+            ctx->gpr[0] = cond_create();
+            break;
+        }
+
+        case SYS_COND_CLOSE: {
+            ctx->gpr[0] = cond_destroy(ctx->gpr[0]);
+            break;
+        }
+
+        case SYS_COND_WAIT: {
+            // Release the mutex and sleep until signalled and the mutex has been taken back
+            int r = cond_sleep(ctx->gpr[0], ctx->gpr[1], running);
+            ctx->gpr[0] = r;
+            if (r == 0) {
+                block(ctx);
+            }
+            break;
+        }
+
+        case SYS_COND_SIGNAL: {
+            // Move one waiter (or all of them, if r1 is set) back onto the mutex, returning how many were moved
+            ctx->gpr[0] = cond_wake(ctx->gpr[0], ctx->gpr[1] != 0);
+            if (preempted()) {
+                schedule(ctx);
+            }
+            break;
+        }
+
+        case SYS_LOCK_STATS: {
+            // Copy the lock counters out to the given structure
+            if (!user_ok((void*) ctx->gpr[0], sizeof(lock_stat_t))) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            lock_get_stats((lock_stat_t*) ctx->gpr[0]);
+            break;
+        }
+
+        case SYS_CLOCK: {
+            // Read the 24MHz system counter, for timing in user programs
+            ctx->gpr[0] = SYSCONF->COUNTER_24MHZ;
+            break;
+        }
+
+        case SYS_IPC_SEND: {
+            // Send r1-r8 to process r0 and wait for its reply (in r1-r8), going straight to it if it is waiting to receive
+            pcb_t* server = search_list(ptable, ctx->gpr[0]);
+            if (server == NULL || server == running) {
+                ctx->gpr[0] = -1;
+            } else if (server->ipc_state == IPC_RECEIVING) {
+                ipc_deliver(ctx, running, server);
+                hand_over(ctx, server);
+            } else {
+                ipc_queue(running, server);
+                block(ctx);
+            }
+            break;
+        }
+
+        case SYS_IPC_RECEIVE: {
+            // Take the next message into r1-r8 and its sender's pid into r0, blocking until there is one
+            if (ipc_take(running, ctx) == NULL) {
+                running->ipc_state = IPC_RECEIVING;
+                block(ctx);
+            }
+            break;
+        }
+
+        case SYS_IPC_REPLY: {
+            // Send r1-r8 back to the client r0, which can then run again
+            pcb_t* client = ipc_reply(running, ctx->gpr[0], ctx);
+            if (client != NULL) {
+                make_ready(client);
+            }
+            ctx->gpr[0] = client == NULL ? -1 : 0;
+            break;
+        }
+
+        case SYS_IPC_REPLY_RECEIVE: {
+            // Reply to client r0 and wait for the next message in one call, going straight back to the client if nobody else is waiting
+            pcb_t* client = ipc_reply(running, ctx->gpr[0], ctx);
+            if (ipc_take(running, ctx) != NULL) {
+                if (client != NULL) {
+                    make_ready(client);
+                }
+            } else {
+                running->ipc_state = IPC_RECEIVING;
+                if (client != NULL) {
+                    hand_over(ctx, client);
+                } else {
+                    block(ctx);
+                }
+            }
+            break;
+        }
+
+        case SYS_POLL: {
+            // Wait for up to r2 ms until one of the r1 descriptors in the array at r0 is ready, returning how many are
+            if (!user_array((pollfd_t*) ctx->gpr[0], ctx->gpr[1] <= FD_MAX ? ctx->gpr[1] : FD_MAX, sizeof(pollfd_t))) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            int r = poll_fds(running, (pollfd_t*) ctx->gpr[0], ctx->gpr[1], ctx->gpr[2]);
+            if (r == POLL_BLOCK) {
+                ctx->pc -= 4;
+                block(ctx);
+                break;
+            }
+            ctx->gpr[0] = r;
+            break;
+        }
+
+        case SYS_MQ_OPEN: {
+            // Open (or create) the named queue, returning its id
+            ctx->gpr[0] = user_str((const char*) ctx->gpr[0]) ? mq_open_queue((const char*) ctx->gpr[0], ctx->gpr[1], ctx->gpr[2]) : -1;
+            break;
+        }
+
+        case SYS_MQ_CLOSE: {
+            ctx->gpr[0] = mq_close_queue(ctx->gpr[0]);
+            break;
+        }
+
+        case SYS_MQ_UNLINK: {
+            ctx->gpr[0] = user_str((const char*) ctx->gpr[0]) ? mq_unlink_queue((const char*) ctx->gpr[0]) : -1;
+            break;
+        }
+
+        case SYS_MQ_SEND: {
+            // Send r2 bytes at r1 with priority r3, blocking (and restarting the call once woken) for up to r4 ms while the queue is full
+            if (!user_ok((void*) ctx->gpr[1], ctx->gpr[2])) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            int r = mq_send_msg(running, ctx->gpr[0], (const uint8_t*) ctx->gpr[1], ctx->gpr[2], ctx->gpr[3], ctx->gpr[4]);
+            if (r == MQ_BLOCK) {
+                ctx->pc -= 4;
+                block(ctx);
+                break;
+            }
+            ctx->gpr[0] = r;
+            break;
+        }
+
+        case SYS_MQ_RECEIVE: {
+            // Receive into the r2 byte buffer at r1 (and the priority into r3), blocking for up to r4 ms while the queue is empty
+            if (!user_ok((void*) ctx->gpr[1], ctx->gpr[2]) || !user_ok((void*) ctx->gpr[3], sizeof(uint32_t))) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            int r = mq_receive_msg(running, ctx->gpr[0], (uint8_t*) ctx->gpr[1], ctx->gpr[2], (uint32_t*) ctx->gpr[3], ctx->gpr[4]);
+            if (r == MQ_BLOCK) {
+                ctx->pc -= 4;
+                block(ctx);
+                break;
+            }
+            ctx->gpr[0] = r;
+            break;
+        }
+
+        case SYS_SYNC: {
+            // Write the free space bitmaps and every dirty block in the buffer cache back to the disk
+            ctx->gpr[0] = fs_sync();
+            break;
+        }
+
+        case SYS_BCACHE_STATS: {
+            // Copy the buffer cache counters out to the given structure
+            if (!user_ok((void*) ctx->gpr[0], sizeof(bcache_stat_t))) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            bcache_get_stats((bcache_stat_t*) ctx->gpr[0]);
+            break;
+        }
+
+        case SYS_DCACHE_STATS: {
+            // Copy the path lookup cache counters out to the given structure
+            if (!user_ok((void*) ctx->gpr[0], sizeof(dcache_stat_t))) {
+                ctx->gpr[0] = -1;
+                break;
+            }
+            dcache_get_stats((dcache_stat_t*) ctx->gpr[0]);
             break;
         }
     }
@@ -16,12 +16,60 @@
 // Include functionality relating to the kernel
 
 #include "int.h"
+#include "alloc.h"
 #include "process.h"
 #include "file.h"
+#include "dir.h"
+#include "dcache.h"
+#include "icache.h"
+#include "vm.h"
+#include "shm.h"
+#include "mmap.h"
+#include "swap.h"
+#include "sem.h"
+#include "futex.h"
+#include "pipe.h"
+#include "mutex.h"
+#include "mqueue.h"
+#include "ipc.h"
+#include "poll.h"
 
 // Include automatic startup program
 extern void* main_console;
 
+// Kernel mode stacks, set up by the linker
+extern uint32_t bos_irq, tos_irq;
+extern uint32_t bos_svc, tos_svc;
+extern uint32_t bos_abt, tos_abt;
+
+// Stack usage of a kernel mode stack (pid -1) or a process, as reported to user programs
+typedef struct {
+    const char* name;
+    int pid;
+    uint32_t size;
+    uint32_t used;
+} stack_mark_t;
+
+// Process information, as reported to user programs
+typedef struct {
+    int pid;
+    const char* name;
+    uint32_t stack;
+} proc_info_t;
+
+// Kinds of statistics returned by SYS_MEM_STATS
+#define MEM_SITES  ( 0x0 )
+#define MEM_CACHES ( 0x1 )
+#define MEM_STACKS ( 0x2 )
+
+// Directory descriptor meaning the cwd, for the path system calls
+#define AT_FDCWD ( -100 )
+
+// Where SYS_LSEEK measures the new offset from
+#define SEEK_SET ( 0x0 )
+#define SEEK_CUR ( 0x1 )
+#define SEEK_END ( 0x2 )
+
 // Useful process variables
 extern int next_pid;
 extern int num_procs;
@@ -47,5 +95,45 @@ extern int num_procs;
 #define SYS_GETCWD    ( 0x17 )
 #define SYS_LISTDIR   ( 0x18 )
 #define SYS_LOAD      ( 0x19 )
+#define SYS_SBRK      ( 0x1A )
+#define SYS_SHM_CREATE ( 0x1B )
+#define SYS_SHM_ATTACH ( 0x1C )
+#define SYS_SHM_DETACH ( 0x1D )
+#define SYS_MMAP      ( 0x1E )
+#define SYS_MUNMAP    ( 0x1F )
+#define SYS_MSYNC     ( 0x20 )
+#define SYS_SWAP_STATS ( 0x21 )
+#define SYS_MEM_STATS ( 0x22 )
+#define SYS_SEM_WAIT  ( 0x23 )
+#define SYS_SEM_POST  ( 0x24 )
+#define SYS_FUTEX     ( 0x25 )
+#define SYS_PIPE      ( 0x26 )
+#define SYS_DUP2      ( 0x27 )
+#define SYS_KMUTEX_INIT   ( 0x28 )
+#define SYS_KMUTEX_CLOSE  ( 0x29 )
+#define SYS_KMUTEX_LOCK   ( 0x2A )
+#define SYS_KMUTEX_UNLOCK ( 0x2B )
+#define SYS_COND_INIT     ( 0x2C )
+#define SYS_COND_CLOSE    ( 0x2D )
+#define SYS_COND_WAIT     ( 0x2E )
+#define SYS_COND_SIGNAL   ( 0x2F )
+#define SYS_LOCK_STATS    ( 0x30 )
+#define SYS_CLOCK         ( 0x31 )
+#define SYS_MQ_OPEN       ( 0x32 )
+#define SYS_MQ_CLOSE      ( 0x33 )
+#define SYS_MQ_UNLINK     ( 0x34 )
+#define SYS_MQ_SEND       ( 0x35 )
+#define SYS_MQ_RECEIVE    ( 0x36 )
+#define SYS_IPC_SEND      ( 0x37 )
+#define SYS_IPC_RECEIVE   ( 0x38 )
+#define SYS_IPC_REPLY     ( 0x39 )
+#define SYS_IPC_REPLY_RECEIVE ( 0x3A )
+#define SYS_POLL          ( 0x3B )
+#define SYS_SYNC          ( 0x3C )
+#define SYS_BCACHE_STATS  ( 0x3D )
+#define SYS_LSEEK         ( 0x3E )
+#define SYS_PREAD         ( 0x3F )
+#define SYS_PWRITE        ( 0x40 )
+#define SYS_DCACHE_STATS  ( 0x41 )
 
 #endif
@@ -0,0 +1,84 @@
+#include "icache.h"
+
+// In-core inodes, the whole inode table is small enough to keep so every inode has its own entry
+cinode_t cinodes[INODES];
+
+// Empty the table
+void icache_init() {
+    memset(cinodes, 0, sizeof(cinodes));
+}
+
+// Get the in-core copy of an inode, to read or change in place (a change must be followed by icache_dirty)
+// -- Only the first use of an inode reads it, every later one is an index into the table.
+inode_t* icache_inode(int inode_num) {
+    cinode_t* c = &cinodes[inode_num];
+    if (!c->valid) {
+        bcache_read(BITMAP_LENGTH + inode_num / INODES_PER_BLOCK, (inode_num % INODES_PER_BLOCK) * INODE_LENGTH, (uint8_t*) &c->inode, sizeof(inode_t));
+        c->valid = true;
+        c->dirty = false;
+    }
+    return &c->inode;
+}
+
+// Replace the in-core copy of an inode, without reading the old one
+void icache_set(int inode_num, const inode_t* inode) {
+    cinode_t* c = &cinodes[inode_num];
+    c->inode = *inode;
+    c->valid = true;
+    c->dirty = true;
+}
+
+// Mark an inode as changed, so it is written back at the next sync
+void icache_dirty(int inode_num) {
+    cinodes[inode_num].dirty = true;
+}
+
+// Take a reference to an inode for an open file or a mapping
+inode_t* icache_get(int inode_num) {
+    cinodes[inode_num].refs++;
+    return icache_inode(inode_num);
+}
+
+// Drop a reference to an inode, freeing it if it was unlinked and this was the last one
+void icache_put(int inode_num) {
+    cinode_t* c = &cinodes[inode_num];
+    c->refs--;
+    if (c->refs == 0 && c->unlinked) {
+        inode_truncate(icache_inode(inode_num), 0);
+        free_inode_block(inode_num);
+    }
+}
+
+// Check whether anything holds a reference to an inode
+bool icache_busy(int inode_num) {
+    return cinodes[inode_num].refs > 0;
+}
+
+// Free an inode (and its blocks) whose last name has gone, now or once nothing holds it
+// -- Whoever has it open keeps reading and writing it as usual until then.
+void icache_unlink(int inode_num) {
+    if (cinodes[inode_num].refs > 0) {
+        cinodes[inode_num].unlinked = true;
+        return;
+    }
+    inode_truncate(icache_inode(inode_num), 0);
+    free_inode_block(inode_num);
+}
+
+// Forget the in-core copy of an inode as it is freed, so nothing stale is written back over it
+void icache_forget(int inode_num) {
+    cinodes[inode_num] = (cinode_t) {0};
+}
+
+// Write every dirty inode into its inode block, returns how many were written
+int icache_sync() {
+    int n = 0;
+    for (int i = 0; i < INODES; i++) {
+        if (cinodes[i].valid && cinodes[i].dirty) {
+            bcache_write(BITMAP_LENGTH + i / INODES_PER_BLOCK, (i % INODES_PER_BLOCK) * INODE_LENGTH, (uint8_t*) &cinodes[i].inode, sizeof(inode_t));
+            cinodes[i].dirty = false;
+            n++;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,48 @@
+#ifndef __ICACHE_H
+#define __ICACHE_H
+
+// Standard definition includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Inodes and the blocks of a file
+#include "file.h"
+
+// In-core copy of an inode, read from its inode block the first time it is needed and kept from then on
+// -- refs counts the open files and file mappings holding the inode, an inode unlinked while held is only freed once the last one lets go.
+// -- A dirty inode has changed since it was last written into its inode block, which happens at the next sync.
+typedef struct {
+    bool valid;
+    bool dirty;
+    bool unlinked;
+    int refs;
+    inode_t inode;
+} cinode_t;
+
+// Empty the table
+void icache_init();
+
+// Get the in-core copy of an inode, to read or change in place (a change must be followed by icache_dirty)
+inode_t* icache_inode(int inode_num);
+// Replace the in-core copy of an inode, without reading the old one
+void icache_set(int inode_num, const inode_t* inode);
+// Mark an inode as changed, so it is written back at the next sync
+void icache_dirty(int inode_num);
+
+// Take or drop a reference to an inode for an open file or a mapping, dropping the last one frees an unlinked inode
+inode_t* icache_get(int inode_num);
+void icache_put(int inode_num);
+// Check whether anything holds a reference to an inode
+bool icache_busy(int inode_num);
+
+// Free an inode (and its blocks) whose last name has gone, now or once nothing holds it
+void icache_unlink(int inode_num);
+// Forget the in-core copy of an inode as it is freed
+void icache_forget(int inode_num);
+
+// Write every dirty inode into its inode block, returns how many were written
+int icache_sync();
+
+#endif
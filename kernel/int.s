@@ -4,7 +4,7 @@ int_data:
     b .                     @ undefined instruction vector -> UND mode
     ldr pc, int_addr_svc    @ supervisor call vector -> SVC mode
     b .                     @ pre-fetch abort vector -> ABT mode
-    b .                     @ data abort vector -> ABT mode
+    ldr pc, int_addr_dab    @ data abort vector -> ABT mode
     b .                     @ reserved
     ldr pc, int_addr_irq    @ IRQ vector -> IRQ mode
     b .                     @ FIQ vector -> FIQ mode
@@ -14,6 +14,8 @@ int_addr_rst:
     .word lolevel_handler_rst
 int_addr_svc:
     .word lolevel_handler_svc
+int_addr_dab:
+    .word lolevel_handler_dab
 int_addr_irq:
     .word lolevel_handler_irq
 	
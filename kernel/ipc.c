@@ -0,0 +1,65 @@
+#include "ipc.h"
+
+// Copy a message between register sets, the words sit in r1-r8
+void ipc_copy(uint32_t* dst, const uint32_t* src) {
+    memcpy(&dst[1], &src[1], IPC_WORDS * sizeof(uint32_t));
+}
+
+// Queue a client on a server until the server receives its message
+// -- The message stays in the client's saved registers until then.
+void ipc_queue(pcb_t* client, pcb_t* server) {
+    client->ipc_state = IPC_SENDING;
+    client->ipc_peer = server->pid;
+    wait_on(&server->ipc_senders, client);
+}
+
+// Take the longest waiting client's message into the server's registers, returns the client (or NULL if none is waiting)
+pcb_t* ipc_take(pcb_t* server, ctx_t* ctx) {
+    pcb_t* client = wake_first(&server->ipc_senders);
+    if (client == NULL) {
+        return NULL;
+    }
+    ipc_copy(ctx->gpr, client->ctx.gpr);
+    ctx->gpr[0] = client->pid;
+    client->ipc_state = IPC_REPLY;
+    return client;
+}
+
+// Hand a message straight from a client's registers to a server blocked in receive
+void ipc_deliver(ctx_t* ctx, pcb_t* client, pcb_t* server) {
+    ipc_copy(server->ctx.gpr, ctx->gpr);
+    server->ctx.gpr[0] = client->pid;
+    server->ipc_state = IPC_NONE;
+    client->ipc_state = IPC_REPLY;
+    client->ipc_peer = server->pid;
+}
+
+// Copy a server's reply into the registers of the client waiting on it, returns the client (or NULL if pid is not waiting on server)
+pcb_t* ipc_reply(pcb_t* server, int pid, ctx_t* ctx) {
+    pcb_t* client = search_list(ptable, pid);
+    if (client == NULL || client->ipc_state != IPC_REPLY || client->ipc_peer != server->pid) {
+        return NULL;
+    }
+    ipc_copy(client->ctx.gpr, ctx->gpr);
+    client->ctx.gpr[0] = 0;
+    client->ipc_state = IPC_NONE;
+    return client;
+}
+
+// Fail every exchange a dying process is the server of
+void ipc_exit(pcb_t* p) {
+    pcb_t* client;
+    while ((client = wake_first(&p->ipc_senders)) != NULL) {
+        client->ctx.gpr[0] = -1;
+        client->ipc_state = IPC_NONE;
+        make_ready(client);
+    }
+    for (pnode_t* cur = ptable->head; cur != NULL; cur = cur->next) {
+        client = cur->data;
+        if (client->ipc_state == IPC_REPLY && client->ipc_peer == p->pid) {
+            client->ctx.gpr[0] = -1;
+            client->ipc_state = IPC_NONE;
+            make_ready(client);
+        }
+    }
+}
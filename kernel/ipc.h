@@ -0,0 +1,36 @@
+#ifndef __IPC_H
+#define __IPC_H
+
+// Standard definition includes
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Process definitions
+#include "process.h"
+
+// Message length in words, messages travel in r1-r8 with r0 holding the pid or result
+#define IPC_WORDS (8)
+
+// Where a process is in a send/receive/reply exchange
+#define IPC_NONE      (0)
+#define IPC_SENDING   (1)
+#define IPC_RECEIVING (2)
+#define IPC_REPLY     (3)
+
+// Process table (in hilevel.c)
+extern plist_t* ptable;
+
+// Queue a client on a server until the server receives its message
+void ipc_queue(pcb_t* client, pcb_t* server);
+// Take the longest waiting client's message into the server's registers, returns the client (or NULL if none is waiting)
+pcb_t* ipc_take(pcb_t* server, ctx_t* ctx);
+// Hand a message straight from a client's registers to a server blocked in receive
+void ipc_deliver(ctx_t* ctx, pcb_t* client, pcb_t* server);
+// Copy a server's reply into the registers of the client waiting on it, returns the client (or NULL if pid is not waiting on server)
+pcb_t* ipc_reply(pcb_t* server, int pid, ctx_t* ctx);
+
+// Fail every exchange a dying process is the server of
+void ipc_exit(pcb_t* p);
+
+#endif
@@ -2,15 +2,18 @@
 .global lolevel_handler_rst
 .global lolevel_handler_irq
 .global lolevel_handler_svc
+.global lolevel_handler_dab
 
 /* Handle reset interrupt */
 lolevel_handler_rst:
     /* Copy IVT to correct address */
     bl int_init
 
-    /* Initialise stack for IRQ and SVC modes (#0xD2, #0xD3 respectively) */
+    /* Initialise stack for IRQ, ABT and SVC modes (#0xD2, #0xD7, #0xD3 respectively) */
     msr cpsr, #0xD2
     ldr sp, =tos_irq
+    msr cpsr, #0xD7
+    ldr sp, =tos_abt
     msr cpsr, #0xD3
     ldr sp, =tos_svc
     
@@ -85,3 +88,29 @@ lolevel_handler_svc:
 
     /* Return from interrupt */
     movs pc, lr
+
+/* Handle data abort interrupt */
+lolevel_handler_dab:
+    /* Correct return address (lr should point to the faulting instruction so that it is retried) */
+    sub lr, lr, #8
+
+    /* Save current context onto stack, it could either be a process (USR mode) or the kernel (SVC mode) */
+    sub sp, sp, #60
+    stmia sp, {r0-r12, sp, lr}^
+    mrs r0, spsr
+    stmdb sp!, {r0, lr}
+
+    /* Pass the context pointer to the high level handler */
+    mov r0, sp
+
+    /* Call the C code */
+    bl hilevel_handler_dab
+
+    /* Restore the (possibly switched-in) context from the stack */
+    ldmia sp!, {r0, lr}
+    msr spsr, r0
+    ldmia sp, {r0-r12, sp, lr}^
+    add sp, sp, #60
+
+    /* Return from interrupt */
+    movs pc, lr
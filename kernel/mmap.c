@@ -0,0 +1,146 @@
+#include "mmap.h"
+
+// File mappings of every process slot, unused when inode_num is -1
+mmap_t mmaps[MAX_PROCS][VM_MMAP_SLOTS];
+
+// Number of disk blocks held by one page
+#define PAGE_BLOCKS (PAGE_SIZE / BLOCK_LENGTH)
+
+// Clear the mapping tables
+void mmap_init() {
+    for (int i = 0; i < MAX_PROCS; i++) {
+        for (int j = 0; j < VM_MMAP_SLOTS; j++) {
+            mmaps[i][j] = (mmap_t) {-1, 0};
+        }
+    }
+}
+
+// Get the virtual address of an mmap slot in a process window
+uint32_t mmap_slot_addr(uint32_t slot, int i) {
+    return vm_window(slot) + VM_MMAP_OFFSET + i * SECTION_SIZE;
+}
+
+// Find the mapping that starts at addr, returns its index (or -1)
+int mmap_find(uint32_t slot, uint32_t addr) {
+    for (int i = 0; i < VM_MMAP_SLOTS; i++) {
+        if (mmaps[slot][i].inode_num != -1 && mmap_slot_addr(slot, i) == addr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Map a file into a process's window, returns the address (or 0 on failure)
+// -- Nothing is read here, pages are filled from the disk as they are first touched.
+uint32_t mmap_file(uint32_t slot, int inode_num, uint32_t len) {
+    if (inode_num < 0 || len == 0 || len > SECTION_SIZE) {
+        return 0;
+    }
+    for (int i = 0; i < VM_MMAP_SLOTS; i++) {
+        if (mmaps[slot][i].inode_num == -1) {
+            mmaps[slot][i] = (mmap_t) {inode_num, len};
+            icache_get(inode_num);
+            return mmap_slot_addr(slot, i);
+        }
+    }
+    return 0;
+}
+
+// Write back the dirty pages of the mapping at addr
+// -- Pages are mapped read-only until they are written to, so a writable page is a dirty page.
+int mmap_sync(uint32_t slot, uint32_t addr) {
+    int i = mmap_find(slot, addr);
+    if (i == -1) {
+        return -1;
+    }
+    mmap_t* m = &mmaps[slot][i];
+    inode_t* inode = icache_inode(m->inode_num);
+
+    for (uint32_t va = addr; va < addr + m->len; va += PAGE_SIZE) {
+        uint32_t entry = vm_lookup(va);
+        if (entry == L2_FAULT || (entry & L2_AP_MASK) != L2_AP_RW) {
+            continue;
+        }
+        // Only blocks that are part of the file are written, the rest of the page is scratch space
+        uint8_t* page = (uint8_t*) (entry & ~(PAGE_SIZE - 1));
+        uint32_t first = ((va - addr) / PAGE_SIZE) * PAGE_BLOCKS;
+        for (int b = 0; b < PAGE_BLOCKS; b++) {
+            int block = inode_map(inode, first + b, false);
+            if (block != -1) {
+                write_data_block(block, page + b * BLOCK_LENGTH);
+            }
+        }
+        vm_protect(va, L2_AP_RO);
+    }
+    return 0;
+}
+
+// Write back and unmap the mapping at addr
+int mmap_unmap(uint32_t slot, uint32_t addr) {
+    int i = mmap_find(slot, addr);
+    if (i == -1) {
+        return -1;
+    }
+    mmap_sync(slot, addr);
+    vm_unmap_range(addr, addr + SECTION_SIZE);
+    icache_put(mmaps[slot][i].inode_num);
+    mmaps[slot][i] = (mmap_t) {-1, 0};
+    return 0;
+}
+
+// Write back and unmap all of a process slot's mappings
+void mmap_release(uint32_t slot) {
+    for (int i = 0; i < VM_MMAP_SLOTS; i++) {
+        if (mmaps[slot][i].inode_num != -1) {
+            mmap_unmap(slot, mmap_slot_addr(slot, i));
+        }
+    }
+}
+
+// Handle a fault inside a file mapping, returns 0 if it could not be resolved
+int mmap_fault(uint32_t addr, uint32_t status) {
+    // Check the address is inside the mmap area of one of the process windows
+    if (addr < VM_BASE || addr >= VM_BASE + MAX_PROCS * VM_WINDOW) {
+        return 0;
+    }
+    uint32_t slot = (addr - VM_BASE) / VM_WINDOW;
+    uint32_t offset = (addr - VM_BASE) % VM_WINDOW;
+    if (offset < VM_MMAP_OFFSET || offset >= VM_STACK_OFFSET) {
+        return 0;
+    }
+    mmap_t* m = &mmaps[slot][(offset - VM_MMAP_OFFSET) / SECTION_SIZE];
+    uint32_t index = ((offset - VM_MMAP_OFFSET) % SECTION_SIZE) / PAGE_SIZE;
+    if (m->inode_num == -1 || index * PAGE_SIZE >= m->len) {
+        return 0;
+    }
+    uint32_t va = addr & ~(PAGE_SIZE - 1);
+
+    // First write to a clean page, so it is now dirty
+    if (status == FAULT_PERMISSION_PAGE) {
+        vm_protect(va, L2_AP_RW);
+        return 1;
+    }
+    if (status != FAULT_TRANSLATION_PAGE && status != FAULT_TRANSLATION_SECTION) {
+        return 0;
+    }
+
+    // First touch, so fill a fresh page from the file's blocks and map it read-only
+    uint32_t page = alloc_pages(0);
+    if (page == 0) {
+        return 0;
+    }
+    memset((void*) page, 0, PAGE_SIZE);
+    inode_t* inode = icache_inode(m->inode_num);
+    uint32_t first = index * PAGE_BLOCKS;
+    for (int b = 0; b < PAGE_BLOCKS; b++) {
+        int block = inode_map(inode, first + b, false);
+        if (block != -1) {
+            read_data_block(block, (uint8_t*) page + b * BLOCK_LENGTH);
+        }
+    }
+    if (!vm_map_ap(va, page, L2_AP_RO)) {
+        free_pages(page, 0);
+        return 0;
+    }
+    return 1;
+}
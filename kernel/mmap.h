@@ -0,0 +1,36 @@
+#ifndef __MMAP_H
+#define __MMAP_H
+
+// Standard definition includes
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Virtual memory, filesystem and in-core inodes
+#include "vm.h"
+#include "file.h"
+#include "icache.h"
+
+// File mapping, one per mmap slot of a process window
+// -- A mapping holds its in-core inode, so a file removed while mapped stays until it is unmapped.
+typedef struct {
+    int inode_num;
+    uint32_t len;
+} mmap_t;
+
+// Clear the mapping tables
+void mmap_init();
+
+// Map a file into a process's window, returns the address (or 0 on failure)
+uint32_t mmap_file(uint32_t slot, int inode_num, uint32_t len);
+// Write back the dirty pages of the mapping at addr
+int mmap_sync(uint32_t slot, uint32_t addr);
+// Write back and unmap the mapping at addr
+int mmap_unmap(uint32_t slot, uint32_t addr);
+// Write back and unmap all of a process slot's mappings
+void mmap_release(uint32_t slot);
+
+// Handle a fault inside a file mapping, returns 0 if it could not be resolved
+int mmap_fault(uint32_t addr, uint32_t status);
+
+#endif
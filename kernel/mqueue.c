@@ -0,0 +1,176 @@
+#include "mqueue.h"
+
+// Message queue table
+mqueue_t mq_table[MAX_MQUEUES];
+
+// Cache messages are allocated from
+kmem_cache_t* mq_msg_cache;
+
+// Set up the queue table and the message cache
+void mq_init() {
+    memset(mq_table, 0, sizeof(mq_table));
+    mq_msg_cache = cache_create("mq_msg", sizeof(mq_msg_t), 0);
+}
+
+// Check a queue id refers to a queue in use
+bool mq_valid(int id) {
+    return id >= 0 && id < MAX_MQUEUES && mq_table[id].used;
+}
+
+// Find the queue with a given name (or -1)
+int mq_find(const char* name) {
+    for (int id = 0; id < MAX_MQUEUES; id++) {
+        if (mq_table[id].used && !mq_table[id].unlinked && strcmp(mq_table[id].name, name) == 0) {
+            return id;
+        }
+    }
+    return -1;
+}
+
+// Free a queue and any messages still on it
+void mq_free(mqueue_t* q) {
+    while (q->head != NULL) {
+        mq_msg_t* msg = q->head;
+        q->head = msg->next;
+        cache_free(mq_msg_cache, msg);
+    }
+    q->used = false;
+}
+
+// Open the queue with the given name, creating it with room for capacity messages of up to msg_size bytes if needed
+// -- Returns the queue's id (or -1), a capacity of 0 only opens an existing queue.
+int mq_open_queue(const char* name, uint32_t capacity, uint32_t msg_size) {
+    if (name == NULL || strlen(name) >= MQ_NAME_LEN) {
+        return -1;
+    }
+    int id = mq_find(name);
+    if (id != -1) {
+        mq_table[id].refs++;
+        return id;
+    }
+    if (capacity == 0 || capacity > MQ_MAX_MSGS || msg_size == 0 || msg_size > MQ_MSG_SIZE) {
+        return -1;
+    }
+    for (id = 0; id < MAX_MQUEUES; id++) {
+        if (!mq_table[id].used) {
+            mqueue_t* q = &mq_table[id];
+            memset(q, 0, sizeof(mqueue_t));
+            q->used = true;
+            strcpy(q->name, name);
+            q->refs = 1;
+            q->capacity = capacity;
+            q->msg_size = msg_size;
+            return id;
+        }
+    }
+    return -1;
+}
+
+// Close a queue, freeing it if it has been unlinked and nobody else has it open
+int mq_close_queue(int id) {
+    if (!mq_valid(id) || mq_table[id].refs == 0) {
+        return -1;
+    }
+    mq_table[id].refs--;
+    if (mq_table[id].refs == 0 && mq_table[id].unlinked) {
+        mq_free(&mq_table[id]);
+    }
+    return 0;
+}
+
+// Remove a queue's name, so it can no longer be opened
+int mq_unlink_queue(const char* name) {
+    int id = mq_find(name);
+    if (id == -1) {
+        return -1;
+    }
+    mq_table[id].unlinked = true;
+    if (mq_table[id].refs == 0) {
+        mq_free(&mq_table[id]);
+    }
+    return 0;
+}
+
+// Finish a call, dropping the deadline it may have been waiting against
+int mq_done(pcb_t* p, int r) {
+    p->deadline = 0;
+    p->timed_out = 0;
+    return r;
+}
+
+// Queue p on q for a call that cannot go ahead yet, unless it must not wait or its deadline has passed
+// -- The deadline is only set on the first attempt, a restarted call keeps waiting against the same one.
+int mq_wait(pcb_t* p, plist_t* q, int timeout) {
+    if (p->timed_out) {
+        return mq_done(p, MQ_TIMEDOUT);
+    }
+    if (timeout == 0) {
+        return mq_done(p, MQ_AGAIN);
+    }
+    if (timeout > 0 && p->deadline == 0) {
+        p->deadline = deadline_after(timeout);
+    }
+    wait_on(q, p);
+    return MQ_BLOCK;
+}
+
+// Send one message for p, returns the length sent
+// -- The message is copied into a slab buffer, and slotted in behind every message of the same or higher priority.
+int mq_send_msg(pcb_t* p, int id, const uint8_t* msg, uint32_t len, uint32_t prio, int timeout) {
+    if (!mq_valid(id) || len > mq_table[id].msg_size) {
+        return mq_done(p, MQ_ERROR);
+    }
+    mqueue_t* q = &mq_table[id];
+    if (q->count == q->capacity) {
+        return mq_wait(p, &q->senders, timeout);
+    }
+    mq_msg_t* m = cache_alloc(mq_msg_cache);
+    if (m == NULL) {
+        return mq_done(p, MQ_ERROR);
+    }
+    m->prio = prio;
+    m->len = len;
+    memcpy(m->data, msg, len);
+
+    mq_msg_t** link = &q->head;
+    while (*link != NULL && (*link)->prio >= prio) {
+        link = &(*link)->next;
+    }
+    m->next = *link;
+    *link = m;
+    q->count++;
+
+    // There is one more message, so one more receiver can go ahead
+    pcb_t* receiver = wake_first(&q->receivers);
+    if (receiver != NULL) {
+        make_ready(receiver);
+    }
+    return mq_done(p, len);
+}
+
+// Receive the highest priority message for p, returns its length
+int mq_receive_msg(pcb_t* p, int id, uint8_t* buf, uint32_t len, uint32_t* prio, int timeout) {
+    if (!mq_valid(id) || len < mq_table[id].msg_size) {
+        return mq_done(p, MQ_ERROR);
+    }
+    mqueue_t* q = &mq_table[id];
+    if (q->count == 0) {
+        return mq_wait(p, &q->receivers, timeout);
+    }
+    mq_msg_t* m = q->head;
+    q->head = m->next;
+    q->count--;
+    memcpy(buf, m->data, m->len);
+    if (prio != NULL) {
+        *prio = m->prio;
+    }
+    int n = m->len;
+    cache_free(mq_msg_cache, m);
+
+    // There is room for one more message, so one more sender can go ahead
+    pcb_t* sender = wake_first(&q->senders);
+    if (sender != NULL) {
+        make_ready(sender);
+    }
+    return mq_done(p, n);
+}
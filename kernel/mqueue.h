@@ -0,0 +1,69 @@
+#ifndef __MQUEUE_H
+#define __MQUEUE_H
+
+// Standard definition includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Kernel memory and processes
+#include "alloc.h"
+#include "process.h"
+
+// Useful constants
+#define MAX_MQUEUES (16)
+#define MQ_NAME_LEN (16)
+#define MQ_MAX_MSGS (64)
+#define MQ_MSG_SIZE (256)
+
+// Results of a send or receive other than success
+#define MQ_ERROR    (-1)
+#define MQ_TIMEDOUT (-2)
+#define MQ_AGAIN    (-3)
+#define MQ_BLOCK    (-4)
+
+// Timeout meaning wait for as long as it takes
+#define MQ_FOREVER (-1)
+
+// Message, kept in a slab buffer big enough for the largest message
+typedef struct mq_msg_t {
+    struct mq_msg_t* next;
+    uint32_t prio;
+    uint32_t len;
+    uint8_t data[MQ_MSG_SIZE];
+} mq_msg_t;
+
+// Message queue, messages are kept highest priority first (oldest first among equals)
+// -- An unlinked queue keeps working for whoever still has it open, and goes once they have all closed it.
+typedef struct {
+    bool used;
+    bool unlinked;
+    char name[MQ_NAME_LEN];
+    int refs;
+    uint32_t capacity;
+    uint32_t msg_size;
+    uint32_t count;
+    mq_msg_t* head;
+    plist_t senders;
+    plist_t receivers;
+} mqueue_t;
+
+// Set up the queue table and the message cache
+void mq_init();
+
+// Open the queue with the given name, creating it with room for capacity messages of up to msg_size bytes if needed
+// -- Returns the queue's id (or -1), a capacity of 0 only opens an existing queue.
+int mq_open_queue(const char* name, uint32_t capacity, uint32_t msg_size);
+// Close a queue, freeing it if it has been unlinked and nobody else has it open
+int mq_close_queue(int id);
+// Remove a queue's name, so it can no longer be opened
+int mq_unlink_queue(const char* name);
+
+// Send or receive one message for p, returns the length sent or received
+// -- A timeout of 0 never waits, and MQ_FOREVER waits with no deadline.
+// -- If the call must wait it returns MQ_BLOCK having queued p, and the caller blocks p and restarts the call once woken.
+int mq_send_msg(pcb_t* p, int id, const uint8_t* msg, uint32_t len, uint32_t prio, int timeout);
+int mq_receive_msg(pcb_t* p, int id, uint8_t* buf, uint32_t len, uint32_t* prio, int timeout);
+
+#endif
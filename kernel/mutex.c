@@ -0,0 +1,284 @@
+#include "mutex.h"
+
+// Mutex and condition variable tables
+kmutex_t mutex_table[MAX_MUTEXES];
+cond_t cond_table[MAX_CONDS];
+
+// Counters, inversion time is kept in microseconds
+uint32_t locks;
+uint32_t contended;
+uint32_t inversions;
+uint32_t boosts;
+uint32_t inversion_us_total;
+uint32_t inversion_us_max;
+
+// Clear the mutex and condition variable tables
+void mutex_table_init() {
+    memset(mutex_table, 0, sizeof(mutex_table));
+    memset(cond_table, 0, sizeof(cond_table));
+    locks = 0;
+    contended = 0;
+    inversions = 0;
+    boosts = 0;
+    inversion_us_total = 0;
+    inversion_us_max = 0;
+}
+
+// Check a mutex id refers to a mutex in use
+bool mutex_valid(int id) {
+    return id >= 0 && id < MAX_MUTEXES && mutex_table[id].used;
+}
+
+// Check a condition variable id refers to one in use
+bool cond_valid(int id) {
+    return id >= 0 && id < MAX_CONDS && cond_table[id].used;
+}
+
+
+/**********************************
+ * PRIORITY INHERITANCE
+**********************************/
+
+// Start timing an inversion, unless the mutex is already held below the level of a waiter
+void start_inversion(kmutex_t* m) {
+    if (!m->inverted) {
+        m->inverted = true;
+        m->inverted_at = SYSCONF->COUNTER_24MHZ;
+    }
+}
+
+// Stop timing an inversion, adding its length to the counters
+void end_inversion(kmutex_t* m) {
+    if (m->inverted) {
+        uint32_t us = (SYSCONF->COUNTER_24MHZ - m->inverted_at) / 24;
+        inversion_us_total += us;
+        if (us > inversion_us_max) {
+            inversion_us_max = us;
+        }
+        m->inverted = false;
+    }
+}
+
+// Get the mutex p is queued for (or NULL)
+// -- A process waiting on a condition variable also remembers its mutex, but is not queued for it yet.
+kmutex_t* waiting_for(pcb_t* p) {
+    if (p->lock_wait != -1 && p->wait_queue == &mutex_table[p->lock_wait].waiters) {
+        return &mutex_table[p->lock_wait];
+    }
+    return NULL;
+}
+
+// Get the highest level among the waiters of every mutex p holds (or -1 if there are none)
+int inherited_level(pcb_t* p) {
+    int level = -1;
+    for (int id = 0; id < MAX_MUTEXES; id++) {
+        if (mutex_table[id].used && mutex_table[id].owner == p) {
+            for (pnode_t* cur = mutex_table[id].waiters.head; cur != NULL; cur = cur->next) {
+                if (pcb_level(cur->data) > level) {
+                    level = pcb_level(cur->data);
+                }
+            }
+        }
+    }
+    return level;
+}
+
+// Lend a level to the owner of a mutex, and on down the chain of owners that are themselves queued for a mutex
+// -- The chain cannot be longer than the number of mutexes, which also stops a deadlock cycle from looping forever.
+void inherit(kmutex_t* m, int level) {
+    for (int depth = 0; m != NULL && m->owner != NULL && depth < MAX_MUTEXES; depth++) {
+        pcb_t* owner = m->owner;
+        if (pcb_level(owner) >= level) {
+            return;
+        }
+        set_boost(owner, level);
+        boosts++;
+        m = waiting_for(owner);
+    }
+}
+
+
+/**********************************
+ * MUTEXES
+**********************************/
+
+// Create a mutex, returns its id (or -1)
+int kmutex_create() {
+    for (int id = 0; id < MAX_MUTEXES; id++) {
+        if (!mutex_table[id].used) {
+            mutex_table[id] = (kmutex_t) {true, NULL, {NULL, NULL}, false, 0};
+            return id;
+        }
+    }
+    return -1;
+}
+
+// Remove a mutex, fails (-1) while it is held
+int kmutex_destroy(int id) {
+    if (!mutex_valid(id) || mutex_table[id].owner != NULL) {
+        return -1;
+    }
+    mutex_table[id].used = false;
+    return 0;
+}
+
+// Take a mutex for p if it is free, otherwise queue p on it and lend p's level to the owner
+// -- Returns 1 if p now holds the mutex, 0 if p has been queued.
+int acquire(int id, pcb_t* p) {
+    kmutex_t* m = &mutex_table[id];
+    if (m->owner == NULL) {
+        m->owner = p;
+        locks++;
+        return 1;
+    }
+    contended++;
+    if (pcb_level(m->owner) < pcb_level(p)) {
+        inversions++;
+        start_inversion(m);
+    }
+    p->lock_wait = id;
+    wait_on(&m->waiters, p);
+    inherit(m, pcb_level(p));
+    return 0;
+}
+
+// Pass a mutex on to its most urgent waiter (the longest waiting among equals), returns the new owner (or NULL)
+// -- The old owner drops back to whatever it still inherits from other mutexes it holds.
+pcb_t* hand_off(kmutex_t* m) {
+    pcb_t* old = m->owner;
+    end_inversion(m);
+
+    pcb_t* next = NULL;
+    for (pnode_t* cur = m->waiters.head; cur != NULL; cur = cur->next) {
+        if (next == NULL || pcb_level(cur->data) > pcb_level(next)) {
+            next = cur->data;
+        }
+    }
+    m->owner = next;
+    set_boost(old, inherited_level(old));
+    if (next == NULL) {
+        return NULL;
+    }
+
+    stop_waiting(next);
+    next->lock_wait = -1;
+    locks++;
+    set_boost(next, inherited_level(next));
+    if (next->priority < next->boost) {
+        start_inversion(m);
+    }
+    return next;
+}
+
+// Lock a mutex for p, returns 0 if p has been queued and must block (-1 for a bad id or if p already holds it)
+int kmutex_take(int id, pcb_t* p) {
+    if (!mutex_valid(id) || mutex_table[id].owner == p) {
+        return -1;
+    }
+    return acquire(id, p);
+}
+
+// Unlock a mutex held by p, handing it straight to its most urgent waiter and making that waiter ready
+// -- Returns 0, or -1 if p does not hold the mutex.
+int kmutex_give(int id, pcb_t* p) {
+    if (!mutex_valid(id) || mutex_table[id].owner != p) {
+        return -1;
+    }
+    pcb_t* next = hand_off(&mutex_table[id]);
+    if (next != NULL) {
+        make_ready(next);
+    }
+    return 0;
+}
+
+
+/**********************************
+ * CONDITION VARIABLES
+**********************************/
+
+// Create a condition variable, returns its id (or -1)
+int cond_create() {
+    for (int id = 0; id < MAX_CONDS; id++) {
+        if (!cond_table[id].used) {
+            cond_table[id] = (cond_t) {true, {NULL, NULL}};
+            return id;
+        }
+    }
+    return -1;
+}
+
+// Remove a condition variable, fails (-1) while processes are waiting on it
+int cond_destroy(int id) {
+    if (!cond_valid(id) || !is_empty(&cond_table[id].waiters)) {
+        return -1;
+    }
+    cond_table[id].used = false;
+    return 0;
+}
+
+// Release a mutex held by p and queue p on a condition variable, returns 0 if p must block (-1 on error)
+// -- Both happen inside one system call, so a signal cannot slip in between.
+int cond_sleep(int id, int mutex, pcb_t* p) {
+    if (!cond_valid(id) || !mutex_valid(mutex) || mutex_table[mutex].owner != p) {
+        return -1;
+    }
+    kmutex_give(mutex, p);
+    p->lock_wait = mutex;
+    wait_on(&cond_table[id].waiters, p);
+    return 0;
+}
+
+// Move the longest waiter (or every waiter) back to its mutex, returns how many were moved (or -1)
+// -- A waiter only runs again once it holds the mutex, so it is queued for it here rather than woken straight away.
+int cond_wake(int id, bool all) {
+    if (!cond_valid(id)) {
+        return -1;
+    }
+    int moved = 0;
+    while (!is_empty(&cond_table[id].waiters) && (all || moved == 0)) {
+        pcb_t* p = wake_first(&cond_table[id].waiters);
+        moved++;
+        // A mutex removed in the meantime cannot be retaken, so the waiter just returns
+        if (!mutex_valid(p->lock_wait)) {
+            p->lock_wait = -1;
+            make_ready(p);
+        } else if (acquire(p->lock_wait, p)) {
+            p->lock_wait = -1;
+            make_ready(p);
+        }
+    }
+    return moved;
+}
+
+
+/**********************************
+ * PROCESS EXIT
+**********************************/
+
+// Release whatever a dying process holds or is queued for
+void mutex_exit(pcb_t* p) {
+    // Stop lending p's level through a mutex it will never get
+    kmutex_t* m = waiting_for(p);
+    if (m != NULL) {
+        stop_waiting(p);
+        if (m->owner != NULL) {
+            set_boost(m->owner, inherited_level(m->owner));
+        }
+    }
+    p->lock_wait = -1;
+
+    // Hand on every mutex p still holds
+    for (int id = 0; id < MAX_MUTEXES; id++) {
+        if (mutex_table[id].used && mutex_table[id].owner == p) {
+            pcb_t* next = hand_off(&mutex_table[id]);
+            if (next != NULL) {
+                make_ready(next);
+            }
+        }
+    }
+}
+
+// Copy out the lock counters
+void lock_get_stats(lock_stat_t* stats) {
+    *stats = (lock_stat_t) {locks, contended, inversions, boosts, inversion_us_total, inversion_us_max};
+}
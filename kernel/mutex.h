@@ -0,0 +1,72 @@
+#ifndef __MUTEX_H
+#define __MUTEX_H
+
+// Standard definition includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// System controller (for its 24MHz counter)
+#include "SYS.h"
+
+// Process definitions
+#include "process.h"
+
+// Useful constants
+#define MAX_MUTEXES (32)
+#define MAX_CONDS (32)
+
+// Kernel mutex, the owner inherits the ready queue level of its most urgent waiter
+typedef struct {
+    bool used;
+    pcb_t* owner;
+    plist_t waiters;
+    bool inverted;
+    uint32_t inverted_at;
+} kmutex_t;
+
+// Condition variable, waiters queue up in FIFO order
+typedef struct {
+    bool used;
+    plist_t waiters;
+} cond_t;
+
+// Lock counters, inversion time is kept in microseconds
+typedef struct {
+    uint32_t locks;
+    uint32_t contended;
+    uint32_t inversions;
+    uint32_t boosts;
+    uint32_t inversion_us_total;
+    uint32_t inversion_us_max;
+} lock_stat_t;
+
+// Clear the mutex and condition variable tables
+void mutex_table_init();
+
+// Create a mutex, returns its id (or -1)
+int kmutex_create();
+// Remove a mutex, fails (-1) while it is held
+int kmutex_destroy(int id);
+// Lock a mutex for p, returns 0 if p has been queued and must block (-1 for a bad id or if p already holds it)
+int kmutex_take(int id, pcb_t* p);
+// Unlock a mutex held by p, handing it to its most urgent waiter, returns 0 (or -1 if p does not hold it)
+int kmutex_give(int id, pcb_t* p);
+
+// Create a condition variable, returns its id (or -1)
+int cond_create();
+// Remove a condition variable, fails (-1) while processes are waiting on it
+int cond_destroy(int id);
+// Release a mutex held by p and queue p on a condition variable, returns 0 if p must block (-1 on error)
+int cond_sleep(int id, int mutex, pcb_t* p);
+// Move the longest waiter (or every waiter) back to its mutex, returns how many were moved
+int cond_wake(int id, bool all);
+
+// Release whatever a dying process holds or is queued for
+void mutex_exit(pcb_t* p);
+
+// Copy out the lock counters
+void lock_get_stats(lock_stat_t* stats);
+
+#endif
@@ -0,0 +1,236 @@
+#include "pipe.h"
+#include "poll.h"
+
+// Cache pipes are allocated from
+kmem_cache_t* pipe_cache;
+
+// Standard streams, shared by every process and never freed
+fcb_t std_streams[STD_STREAMS];
+
+// Set up the cache pipes are allocated from and the standard streams
+void pipe_init() {
+    pipe_cache = cache_create("pipe", sizeof(pipe_t), 0);
+    for (int i = 0; i < STD_STREAMS; i++) {
+        std_streams[i] = (fcb_t) {i, -1, i == 0 ? READ : WRITE};
+    }
+}
+
+// Create a pipe with no ends attached yet
+pipe_t* pipe_create() {
+    pipe_t* pipe = cache_alloc(pipe_cache);
+    if (pipe != NULL) {
+        memset(pipe, 0, sizeof(pipe_t));
+    }
+    return pipe;
+}
+
+// Copy out up to len bytes, returns how many (0 if the pipe is empty)
+uint32_t pipe_read(pipe_t* pipe, uint8_t* dst, uint32_t len) {
+    uint32_t n = len < pipe->count ? len : pipe->count;
+    for (uint32_t i = 0; i < n; i++) {
+        dst[i] = pipe->buf[(pipe->head + i) % PIPE_SIZE];
+    }
+    pipe->head = (pipe->head + n) % PIPE_SIZE;
+    pipe->count -= n;
+    if (n > 0) {
+        poll_notify();
+    }
+    return n;
+}
+
+// Copy in up to len bytes, returns how many (0 if the pipe is full, or an atomic write does not fit yet)
+uint32_t pipe_write(pipe_t* pipe, const uint8_t* src, uint32_t len) {
+    uint32_t space = PIPE_SIZE - pipe->count;
+    if (len <= PIPE_ATOMIC && len > space) {
+        return 0;
+    }
+    uint32_t n = len < space ? len : space;
+    uint32_t tail = pipe->head + pipe->count;
+    for (uint32_t i = 0; i < n; i++) {
+        pipe->buf[(tail + i) % PIPE_SIZE] = src[i];
+    }
+    pipe->count += n;
+    if (n > 0) {
+        poll_notify();
+    }
+    return n;
+}
+
+// Wake every process waiting on a queue
+void wake_all(plist_t* q) {
+    pcb_t* p;
+    while ((p = wake_first(q)) != NULL) {
+        make_ready(p);
+    }
+}
+
+// Drop one reference to the pipe end behind a file control block
+// -- Once the last reference to an end is gone the other side is woken, to see end-of-file or a broken pipe.
+void pipe_put(fcb_t* fcb) {
+    fcb->refs--;
+    if (fcb->refs > 0) {
+        return;
+    }
+    pipe_t* pipe = fcb->pipe;
+    if (fcb->access == READ) {
+        pipe->readers--;
+        wake_all(&pipe->write_waiters);
+    } else {
+        pipe->writers--;
+        wake_all(&pipe->read_waiters);
+    }
+    poll_notify();
+    if (pipe->readers == 0 && pipe->writers == 0) {
+        cache_free(pipe_cache, pipe);
+    }
+    cache_free(file_cache, fcb);
+}
+
+// Drop one reference to an open file, freeing its control block (and its hold on the inode) once the last descriptor referring to it is closed
+// -- The standard streams have no inode and are never freed.
+void file_put(fcb_t* fcb) {
+    fcb->refs--;
+    if (fcb->refs > 0) {
+        return;
+    }
+    icache_put(fcb->inode_num);
+    cache_free(file_cache, fcb);
+}
+
+// Take one more reference to whatever is behind a file control block, for a descriptor duplicated or inherited from another
+void fcb_hold(fcb_t* fcb) {
+    if (fcb->pipe != NULL || fcb->inode_num >= 0) {
+        fcb->refs++;
+    }
+}
+
+// Mark a descriptor as open or closed in the bitmaps
+void fd_mark(pcb_t* p, int fd, bool used) {
+    uint32_t w = fd / 32;
+    if (used) {
+        p->fd_used[w] |= 1u << (fd % 32);
+    } else {
+        p->fd_used[w] &= ~(1u << (fd % 32));
+    }
+    if (p->fd_used[w] == 0xFFFFFFFF) {
+        p->fd_full |= 1u << w;
+    } else {
+        p->fd_full &= ~(1u << w);
+    }
+}
+
+// Grow a process's descriptor table, doubling it until it has room for size descriptors
+int fd_grow(pcb_t* p, uint32_t size) {
+    uint32_t new_size = p->fd_size;
+    while (new_size < size) {
+        new_size *= 2;
+    }
+    fcb_t** table = kmalloc(new_size * sizeof(fcb_t*));
+    if (table == NULL) {
+        return -1;
+    }
+    memcpy(table, p->fdtable, p->fd_size * sizeof(fcb_t*));
+    memset(table + p->fd_size, 0, (new_size - p->fd_size) * sizeof(fcb_t*));
+    kfree(p->fdtable);
+    p->fdtable = table;
+    p->fd_size = new_size;
+    return 0;
+}
+
+// Give a new process an empty descriptor table, apart from the standard streams STDIN, STDOUT and STDERR
+int fd_init(pcb_t* p) {
+    p->fdtable = kmalloc(FD_INITIAL * sizeof(fcb_t*));
+    if (p->fdtable == NULL) {
+        return -1;
+    }
+    memset(p->fdtable, 0, FD_INITIAL * sizeof(fcb_t*));
+    p->fd_size = FD_INITIAL;
+    memset(p->fd_used, 0, sizeof(p->fd_used));
+    p->fd_full = 0;
+    for (int i = 0; i < 3; i++) {
+        p->fdtable[i] = &std_streams[i];
+        fd_mark(p, i, true);
+    }
+    return 0;
+}
+
+// Give a control block the lowest free descriptor, returns it (or -1)
+// -- The first word of fd_used with a free bit comes from fd_full, so finding the descriptor takes two bit scans however many are open.
+int fd_alloc(pcb_t* p, fcb_t* fcb) {
+    if (p->fd_full == 0xFFFFFFFF) {
+        return -1;
+    }
+    uint32_t w = __builtin_ctz(~p->fd_full);
+    int fd = w * 32 + __builtin_ctz(~p->fd_used[w]);
+    if (fd >= p->fd_size && fd_grow(p, fd + 1) == -1) {
+        return -1;
+    }
+    p->fdtable[fd] = fcb;
+    fd_mark(p, fd, true);
+    return fd;
+}
+
+// Get the control block behind one of a process's descriptors (or NULL if it is not open)
+fcb_t* fd_get(pcb_t* p, int usr_fd) {
+    return (uint32_t) usr_fd < p->fd_size ? p->fdtable[usr_fd] : NULL;
+}
+
+// Close one of a process's descriptors
+void fd_close(pcb_t* p, int usr_fd) {
+    fcb_t* fcb = fd_get(p, usr_fd);
+    if (fcb == NULL) {
+        return;
+    }
+    if (fcb->pipe != NULL) {
+        pipe_put(fcb);
+    } else if (fcb->inode_num >= 0) {
+        file_put(fcb);
+    }
+    p->fdtable[usr_fd] = NULL;
+    fd_mark(p, usr_fd, false);
+}
+
+// Close every descriptor a process has open, and free its descriptor table
+void fd_close_all(pcb_t* p) {
+    for (int i = 0; i < p->fd_size; i++) {
+        fd_close(p, i);
+    }
+    kfree(p->fdtable);
+    p->fdtable = NULL;
+    p->fd_size = 0;
+}
+
+// Give a child its parent's descriptors, sharing the control blocks (and so the offsets) behind them
+int fd_inherit(pcb_t* child, pcb_t* parent) {
+    if (parent->fd_size > child->fd_size && fd_grow(child, parent->fd_size) == -1) {
+        return -1;
+    }
+    for (int i = 0; i < parent->fd_size; i++) {
+        child->fdtable[i] = parent->fdtable[i];
+        if (child->fdtable[i] != NULL) {
+            fcb_hold(child->fdtable[i]);
+        }
+    }
+    memcpy(child->fd_used, parent->fd_used, sizeof(child->fd_used));
+    child->fd_full = parent->fd_full;
+    return 0;
+}
+
+// Make new_fd refer to the same file as old_fd, closing whatever new_fd referred to before
+int fd_dup2(pcb_t* p, int old_fd, int new_fd) {
+    fcb_t* fcb = fd_get(p, old_fd);
+    if (fcb == NULL || new_fd < 0 || new_fd >= FD_MAX) {
+        return -1;
+    }
+    if (old_fd == new_fd) {
+        return new_fd;
+    }
+    if (new_fd >= p->fd_size && fd_grow(p, new_fd + 1) == -1) {
+        return -1;
+    }
+    fd_close(p, new_fd);
+    p->fdtable[new_fd] = fcb;
+    fd_mark(p, new_fd, true);
+    fcb_hold(fcb);
+    return new_fd;
+}
@@ -0,0 +1,62 @@
+#ifndef __PIPE_H
+#define __PIPE_H
+
+// Standard definition includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Kernel memory, processes, files and in-core inodes
+#include "alloc.h"
+#include "process.h"
+#include "file.h"
+#include "icache.h"
+
+// Useful constants
+// -- Writes of up to PIPE_ATOMIC bytes are never split up or interleaved with other writers.
+#define PIPE_SIZE (1024)
+#define PIPE_ATOMIC (128)
+#define STD_STREAMS (4)
+
+// Pipe, a ring buffer shared by a read end and a write end
+typedef struct pipe_t {
+    uint8_t buf[PIPE_SIZE];
+    uint32_t head;
+    uint32_t count;
+    int readers;
+    int writers;
+    plist_t read_waiters;
+    plist_t write_waiters;
+} pipe_t;
+
+// Cache pipes are allocated from, and the standard streams every process starts with (STDIN, STDOUT, STDERR and CONOUT)
+extern kmem_cache_t* pipe_cache;
+extern fcb_t std_streams[STD_STREAMS];
+
+// Set up the cache pipes are allocated from and the standard streams
+void pipe_init();
+
+// Create a pipe with no ends attached yet
+pipe_t* pipe_create();
+
+// Copy out up to len bytes, returns how many (0 if the pipe is empty)
+uint32_t pipe_read(pipe_t* pipe, uint8_t* dst, uint32_t len);
+// Copy in up to len bytes, returns how many (0 if the pipe is full, or an atomic write does not fit yet)
+uint32_t pipe_write(pipe_t* pipe, const uint8_t* src, uint32_t len);
+
+// Wake every process waiting on a queue
+void wake_all(plist_t* q);
+
+// Descriptor management for the files a process has open
+// -- fd_alloc gives the lowest free descriptor, and fd_get the control block behind a descriptor (or NULL if it is not open).
+// -- fd_init, fd_alloc, fd_inherit and fd_dup2 return -1 if the table cannot grow (or the descriptor is past FD_MAX).
+int fd_init(pcb_t* p);
+int fd_alloc(pcb_t* p, fcb_t* fcb);
+fcb_t* fd_get(pcb_t* p, int usr_fd);
+void fd_close(pcb_t* p, int usr_fd);
+void fd_close_all(pcb_t* p);
+int fd_inherit(pcb_t* child, pcb_t* parent);
+int fd_dup2(pcb_t* p, int old_fd, int new_fd);
+
+#endif
@@ -0,0 +1,98 @@
+#include "poll.h"
+
+// Processes blocked in poll, and processes waiting for input on STDIN
+plist_t pollers;
+plist_t stdin_waiters;
+
+// Clear the wait queues, with the STDIN UART's receive interrupts off until somebody waits for input
+void poll_init() {
+    pollers = (plist_t) {NULL, NULL};
+    stdin_waiters = (plist_t) {NULL, NULL};
+    UART1->IMSC &= ~UART_RX_INTS;
+}
+
+// Turn on the STDIN UART's receive interrupts, they are turned off again by the first one to arrive
+// -- Input that came in before this raises the interrupt straight away, so it cannot be missed.
+void stdin_arm() {
+    UART1->IMSC |= UART_RX_INTS;
+}
+
+// Get the events ready on one of p's descriptors
+short fd_revents(pcb_t* p, int usr_fd, short events) {
+    fcb_t* fcb = fd_get(p, usr_fd);
+    if (fcb == NULL) {
+        return POLLNVAL;
+    }
+
+    // A pipe end is ready once there is data (or room for an atomic write), and hung up once the other side has gone
+    if (fcb->pipe != NULL) {
+        pipe_t* pipe = fcb->pipe;
+        if (fcb->access == READ) {
+            return (pipe->count > 0 ? events & POLLIN : 0) | (pipe->writers == 0 ? POLLHUP : 0);
+        }
+        return (PIPE_SIZE - pipe->count >= PIPE_ATOMIC ? events & POLLOUT : 0) | (pipe->readers == 0 ? POLLHUP : 0);
+    }
+    // STDIN is readable when the UART has input, everything else (the output UARTs and files) never waits
+    if (fcb->stream == 0) {
+        return PL011_can_getc(UART1) ? events & POLLIN : 0;
+    }
+    return events & (POLLIN | POLLOUT);
+}
+
+// Check n descriptors for p, returns how many are ready (or POLL_BLOCK if p has been queued until something changes)
+// -- The deadline is only set on the first attempt, a restarted call keeps waiting against the same one.
+int poll_fds(pcb_t* p, pollfd_t* fds, uint32_t n, int timeout) {
+    if (n > FD_MAX || (fds == NULL && n != 0)) {
+        return -1;
+    }
+    int ready = 0;
+    bool wants_stdin = false;
+    for (uint32_t i = 0; i < n; i++) {
+        // A negative descriptor is ignored, as a program drops one from its set without moving the others
+        fds[i].revents = 0;
+        if (fds[i].fd < 0) {
+            continue;
+        }
+        fds[i].revents = fd_revents(p, fds[i].fd, fds[i].events);
+        if (fds[i].revents != 0) {
+            ready++;
+        }
+        if ((fds[i].events & POLLIN) && fds[i].revents == 0 && fd_get(p, fds[i].fd)->stream == 0) {
+            wants_stdin = true;
+        }
+    }
+    if (ready > 0 || p->timed_out || timeout == 0) {
+        p->deadline = 0;
+        p->timed_out = 0;
+        return ready;
+    }
+
+    if (timeout > 0 && p->deadline == 0) {
+        p->deadline = deadline_after(timeout);
+    }
+    if (wants_stdin) {
+        stdin_arm();
+    }
+    wait_on(&pollers, p);
+    return POLL_BLOCK;
+}
+
+// Wake every process blocked in poll, to check its descriptors again
+void poll_notify() {
+    wake_all(&pollers);
+}
+
+// Queue p until input arrives on STDIN
+void stdin_wait(pcb_t* p) {
+    wait_on(&stdin_waiters, p);
+    stdin_arm();
+}
+
+// Handle the STDIN UART's receive interrupt
+// -- The input is left in the FIFO for the readers, so the interrupt is turned off until somebody waits again.
+void stdin_irq() {
+    UART1->IMSC &= ~UART_RX_INTS;
+    UART1->ICR = UART_RX_INTS;
+    wake_all(&stdin_waiters);
+    poll_notify();
+}
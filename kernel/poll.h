@@ -0,0 +1,48 @@
+#ifndef __POLL_H
+#define __POLL_H
+
+// Standard definition includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Devices, processes and pipes
+#include "PL011.h"
+#include "process.h"
+#include "pipe.h"
+
+// Poll events
+#define POLLIN   (0x01)
+#define POLLOUT  (0x04)
+#define POLLHUP  (0x10)
+#define POLLNVAL (0x20)
+
+// Result of a poll that has queued the caller, which must block and restart the call once woken
+#define POLL_BLOCK (-2)
+
+// UART receive and receive timeout interrupts
+#define UART_RX_INTS (0x50)
+
+// Descriptor to watch, and the events that are ready on it
+typedef struct {
+    int fd;
+    short events;
+    short revents;
+} pollfd_t;
+
+// Clear the wait queues, with the STDIN UART's receive interrupts off until somebody waits for input
+void poll_init();
+
+// Check n descriptors for p, returns how many are ready (or POLL_BLOCK if p has been queued until something changes)
+// -- A timeout of 0 never waits and -1 waits with no deadline.
+int poll_fds(pcb_t* p, pollfd_t* fds, uint32_t n, int timeout);
+// Wake every process blocked in poll, to check its descriptors again
+void poll_notify();
+
+// Queue p until input arrives on STDIN
+void stdin_wait(pcb_t* p);
+// Handle the STDIN UART's receive interrupt
+void stdin_irq();
+
+#endif
@@ -1,4 +1,11 @@
 #include "process.h"
+#include "alloc.h"
+#include "vm.h"
+#include "shm.h"
+#include "mmap.h"
+#include "pipe.h"
+#include "mutex.h"
+#include "ipc.h"
 
 // Stack bitmap
 uint32_t stacks = 0;
@@ -30,55 +37,55 @@ void return_stack(uint32_t num) {
     stacks |= 1 << num;
 }
 
-// Find an unused file descriptor
-void get_next_fd(pcb_t* p) {
-    for (int i = 0; i < MAX_FILES; i++) {
-        if (p->fdtable[i] == -1) {
-            p->next_fd = i;
-            return;
-        }
-    }
-}
-
 // Store the value of the next pid
 int next_pid = 0;
 
 // Number of processes active
 int num_procs = 0;
 
-// Create a new PCB for a process
+// Create a new PCB for a process, returns NULL if there are no free process slots
 pcb_t* create_PCB(const char* name, uint32_t entryPoint, pcb_t* parent) {
+    // Claim a process slot (and with it a stack)
+    uint32_t stack_num = get_stack();
+    if (stack_num == -1) {
+        return NULL;
+    }
+    pcb_t* pcb = cache_alloc(pcb_cache);
+    if (pcb == NULL) {
+        return_stack(stack_num);
+        return NULL;
+    }
+    // Setup the descriptor table, with the standard file descriptors open
+    if (fd_init(pcb) == -1) {
+        cache_free(pcb_cache, pcb);
+        return_stack(stack_num);
+        return NULL;
+    }
     num_procs++;
-    pcb_t* pcb = malloc(sizeof(pcb_t));
 
     pcb->pid = next_pid++;
     pcb->state = CREATED;
-    pcb->name = malloc(sizeof(char) * strlen(name) + 1);
+    pcb->wait_queue = NULL;
+    pcb->deadline = 0;
+    pcb->timed_out = 0;
+    pcb->futex_key = 0;
+    pcb->ipc_state = 0;
+    pcb->ipc_peer = -1;
+    pcb->ipc_senders = (plist_t) {NULL, NULL};
+    pcb->name = kmalloc(sizeof(char) * strlen(name) + 1);
     memcpy(pcb->name, name, sizeof(char) * strlen(name) + 1);
     pcb->parent = parent;
 
     pcb->priority = MAX_PRIORITY;
+    pcb->boost = -1;
+    pcb->lock_wait = -1;
     pcb->timeslice = 1;
     
-    // Setup initial standard file descriptors
-    pcb->fdtable[0] = 0;
-    pcb->fdtable[1] = 1;
-    pcb->fdtable[2] = 2;
-    for (int j = 3; j < MAX_FILES; j++) {
-        pcb->fdtable[j] = -1;
-    }
-    
-    // Store the value of the next file_descriptor
-    pcb->next_fd = 3;
-    strcpy(pcb->cwd, "/");
+    pcb->cwd = 0;
 
     // Set the top of the process's stack
-    pcb->stack_num = get_stack();
-    if (pcb->stack_num < 0) {
-        // Error......
-    }
-
-    pcb->ptos = ((uint32_t) &usr_stacks) - (((uint32_t) &proc_stack_size) * pcb->stack_num);
+    pcb->stack_num = stack_num;
+    pcb->ptos = vm_stack_top(pcb->stack_num);
 
     // Initialise context
     pcb->ctx.cpsr = 0x50;
@@ -92,17 +99,51 @@ pcb_t* create_PCB(const char* name, uint32_t entryPoint, pcb_t* parent) {
     return pcb;
 }
 
+// Create the PCB for the idle process, which runs on the small stack ending at tos
+// -- It takes no pid, process slot or descriptors and is not counted in num_procs, so every slot is left for user processes.
+pcb_t* create_idle_PCB(uint32_t entryPoint, uint32_t tos) {
+    pcb_t* pcb = cache_alloc(pcb_cache);
+    if (pcb == NULL) {
+        return NULL;
+    }
+    memset(pcb, 0, sizeof(pcb_t));
+    pcb->pid = -1;
+    pcb->name = "idle";
+    pcb->state = CREATED;
+    pcb->ipc_peer = -1;
+    pcb->priority = MAX_PRIORITY;
+    pcb->boost = -1;
+    pcb->lock_wait = -1;
+    pcb->timeslice = 1;
+    pcb->stack_num = -1;
+    pcb->ptos = tos;
+
+    pcb->ctx.cpsr = 0x50;
+    pcb->ctx.pc = entryPoint;
+    pcb->ctx.sp = tos;
+    return pcb;
+}
+
 // Delete a process
 void destroy_PCB(pcb_t* p) {
     num_procs--;
     p->state = TERMINATED;
+    mutex_exit(p);
+    ipc_exit(p);
+    stop_waiting(p);
+    fd_close_all(p);
+    shm_release(p->stack_num);
+    mmap_release(p->stack_num);
+    vm_stack_release(p->stack_num);
+    vm_heap_release(p->stack_num);
     return_stack(p->stack_num);
-    free(p);
+    kfree(p->name);
+    cache_free(pcb_cache, p);
 }
 
 // Create a process list
 plist_t* create_list() {
-    plist_t* l = malloc(sizeof(plist_t));
+    plist_t* l = cache_alloc(plist_cache);
     l->head = NULL;
     l->tail = NULL;
     return l;
@@ -114,18 +155,18 @@ void free_list(plist_t* l) {
         pnode_t* prev = l->head;
         pnode_t* cur = prev->next;
         while (cur->next != NULL) {
-            free(prev);
+            cache_free(pnode_cache, prev);
             prev = cur;
             cur = cur->next;
         }
-        free(cur);
+        cache_free(pnode_cache, cur);
     }
-    free(l);
+    cache_free(plist_cache, l);
 }
 
 // Add process to end of list
 void push_list(plist_t* l, pcb_t* pcb) {
-    pnode_t* node = malloc(sizeof(pnode_t));
+    pnode_t* node = cache_alloc(pnode_cache);
     node->data = pcb;
     node->next = NULL;
     if (is_empty(l)) {
@@ -148,7 +189,7 @@ pcb_t* pop_list(plist_t* l) {
         if (node->next == NULL) {
             l->tail = NULL;
         }
-        free(node);
+        cache_free(pnode_cache, node);
         return pcb;
     }
 }
@@ -184,7 +225,7 @@ pcb_t* delete_list(plist_t* l, int pid) {
     }
 
     pcb_t* pcb = cur->data;
-    free(cur);
+    cache_free(pnode_cache, cur);
     return pcb;
 }
 
@@ -210,3 +251,68 @@ pcb_t* search_list(plist_t* l, int pid) {
 int is_empty(plist_t* l) {
     return l->head == NULL;
 }
+
+// Processes blocked with a deadline, and ticks since the kernel started
+plist_t timed_waiters;
+uint32_t ticks;
+
+// Queue a process on a wait queue
+void wait_on(plist_t* q, pcb_t* p) {
+    push_list(q, p);
+    p->wait_queue = q;
+    if (p->deadline != 0) {
+        push_list(&timed_waiters, p);
+    }
+}
+
+// Take the longest waiting process off a wait queue (or NULL)
+pcb_t* wake_first(plist_t* q) {
+    pcb_t* p = pop_list(q);
+    if (p != NULL) {
+        p->wait_queue = NULL;
+        if (p->deadline != 0) {
+            delete_list(&timed_waiters, p->pid);
+        }
+    }
+    return p;
+}
+
+// Take a process off the wait queue it is blocked on, if any
+void stop_waiting(pcb_t* p) {
+    if (p->wait_queue != NULL) {
+        delete_list(p->wait_queue, p->pid);
+        p->wait_queue = NULL;
+        if (p->deadline != 0) {
+            delete_list(&timed_waiters, p->pid);
+        }
+    }
+}
+
+// Get the tick by which a wait of ms milliseconds ends (never 0, which means no deadline)
+uint32_t deadline_after(uint32_t ms) {
+    if (ms > MAX_TIMEOUT_MS) {
+        ms = MAX_TIMEOUT_MS;
+    }
+    uint32_t deadline = ticks + (ms * 1000 + TICK_US - 1) / TICK_US;
+    return deadline == 0 ? 1 : deadline;
+}
+
+// Count a timer tick, waking every process whose deadline has passed
+void timeout_tick() {
+    ticks++;
+    pnode_t* cur = timed_waiters.head;
+    while (cur != NULL) {
+        pcb_t* p = cur->data;
+        cur = cur->next;
+        if ((int32_t) (ticks - p->deadline) >= 0) {
+            stop_waiting(p);
+            p->timed_out = 1;
+            make_ready(p);
+        }
+    }
+}
+
+// Ready queue level of a process, its own priority or a higher one inherited through a mutex
+int pcb_level(pcb_t* p) {
+    return p->boost > p->priority ? p->boost : p->priority;
+}
@@ -8,14 +8,20 @@
 #include <string.h>
 
 // Useful Constants
-#define MAX_FILES (32)
 #define MAX_PRIORITY (2)
-#define MAX_PATH (512)
+#define MAX_PROCS (32)
 
-// Top of section for all user process stacks
-extern uint32_t usr_stacks;
+// Length of a timer tick in microseconds (the SP804 counts 0x1000 cycles of its 1MHz clock), and the longest timeout
+#define TICK_US (4096)
+#define MAX_TIMEOUT_MS (1000000)
+
+// Descriptors a process's table starts with room for, and the most it can have open (one word of fd_full covers them all)
+#define FD_INITIAL (16)
+#define FD_MAX (1024)
+#define FD_WORDS (FD_MAX / 32)
+
+// Number of process slots (and so virtual windows) set up by the linker
 extern uint32_t max_procs;
-extern uint32_t proc_stack_size;
 
 // Context for process, i.e. all the registers associated with a process
 typedef struct {
@@ -31,42 +37,54 @@ typedef enum {
     TERMINATED
 } pstate_t;
 
+// Process list node
+typedef struct pnode_t {
+    struct pcb_t* data;
+    struct pnode_t* next;
+} pnode_t;
+
+// Process linked list
+typedef struct plist_t {
+    pnode_t* head;
+    pnode_t* tail;
+} plist_t;
+
 // Process Control Block (PCB)
+// -- fdtable points at the file control block behind each descriptor (NULL if closed), and doubles in size as more are opened.
+// -- fd_used has a bit set for each open descriptor, and fd_full a bit set for each word of fd_used with none free.
+// -- cwd is the inode number of the current directory, so paths are looked up from it without going back to the root.
 typedef struct pcb_t {
     int pid;
     char* name;
     pstate_t state;
+    struct plist_t* wait_queue;
+    uint32_t deadline;
+    int timed_out;
+    uint32_t futex_key;
+    int ipc_state;
+    int ipc_peer;
+    plist_t ipc_senders;
     struct pcb_t* parent;
     ctx_t ctx;
     uint32_t stack_num;
     uint32_t ptos;
     int priority;
+    int boost;
+    int lock_wait;
     int timeslice;
-    int fdtable[MAX_FILES];
-    int next_fd;
-    char cwd[MAX_PATH];
+    struct fcb_t** fdtable;
+    uint32_t fd_size;
+    uint32_t fd_used[FD_WORDS];
+    uint32_t fd_full;
+    int cwd;
 } pcb_t;
 
-// Process list node
-typedef struct pnode_t {
-    pcb_t* data;
-    struct pnode_t* next;
-} pnode_t;
-
-// Process linked list
-typedef struct {
-    pnode_t* head;
-    pnode_t* tail;
-} plist_t;
-
 // User stack handling
 void init_stacks();
 
-// File descriptor management
-void get_next_fd(pcb_t* p);
-
 // PCB operations
 pcb_t* create_PCB(const char* name, uint32_t entryPoint, pcb_t* parent);
+pcb_t* create_idle_PCB(uint32_t entryPoint, uint32_t tos);
 void destroy_PCB(pcb_t* p);
 
 // List operations
@@ -78,4 +96,22 @@ pcb_t* delete_list(plist_t* l, int pid);
 pcb_t* search_list(plist_t* l, int pid);
 int is_empty(plist_t* l);
 
+// Wait queues, a process remembers the queue it is blocked on so it can be taken off it if killed
+void wait_on(plist_t* q, pcb_t* p);
+pcb_t* wake_first(plist_t* q);
+void stop_waiting(pcb_t* p);
+
+// Timed waits, a process blocking with a deadline set is woken with timed_out set if the deadline passes first
+// -- The deadline is kept across restarts of the system call, and cleared once it completes.
+extern uint32_t ticks;
+uint32_t deadline_after(uint32_t ms);
+void timeout_tick();
+
+// Ready queue level of a process, its own priority or a higher one inherited through a mutex
+int pcb_level(pcb_t* p);
+
+// Scheduler hooks (in hilevel.c), put a process back on the ready queue and change its inherited level
+void make_ready(pcb_t* pcb);
+void set_boost(pcb_t* pcb, int boost);
+
 #endif
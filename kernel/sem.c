@@ -0,0 +1,62 @@
+#include "sem.h"
+
+// Semaphore table
+sem_t sem_table[MAX_SEMS];
+
+// Clear the semaphore table
+void sem_table_init() {
+    memset(sem_table, 0, sizeof(sem_table));
+}
+
+// Check a semaphore id refers to a semaphore in use
+bool sem_valid(int id) {
+    return id >= 0 && id < MAX_SEMS && sem_table[id].used;
+}
+
+// Create a semaphore with an initial value, returns its id (or -1)
+int sem_create(int value) {
+    for (int id = 0; id < MAX_SEMS; id++) {
+        if (!sem_table[id].used) {
+            sem_table[id] = (sem_t) {true, value, {NULL, NULL}};
+            return id;
+        }
+    }
+    return -1;
+}
+
+// Remove a semaphore, fails (-1) while processes are waiting on it
+int sem_destroy(int id) {
+    if (!sem_valid(id) || !is_empty(&sem_table[id].waiters)) {
+        return -1;
+    }
+    sem_table[id].used = false;
+    return 0;
+}
+
+// Take one unit from a semaphore for p, returns 0 if p has been queued and must block (-1 for a bad id)
+int sem_take(int id, pcb_t* p) {
+    if (!sem_valid(id)) {
+        return -1;
+    }
+    sem_t* sem = &sem_table[id];
+    if (sem->value > 0) {
+        sem->value--;
+        return 1;
+    }
+    wait_on(&sem->waiters, p);
+    return 0;
+}
+
+// Give one unit back to a semaphore, returns the waiter it was handed to (or NULL)
+// -- The unit goes straight to the oldest waiter, so a post wakes exactly one process and nobody can barge in.
+pcb_t* sem_give(int id) {
+    if (!sem_valid(id)) {
+        return NULL;
+    }
+    sem_t* sem = &sem_table[id];
+    if (is_empty(&sem->waiters)) {
+        sem->value++;
+        return NULL;
+    }
+    return wake_first(&sem->waiters);
+}
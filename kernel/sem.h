@@ -0,0 +1,36 @@
+#ifndef __SEM_H
+#define __SEM_H
+
+// Standard definition includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Process definitions
+#include "process.h"
+
+// Useful constants
+#define MAX_SEMS (64)
+
+// Kernel semaphore, waiters queue up in FIFO order
+typedef struct {
+    bool used;
+    int value;
+    plist_t waiters;
+} sem_t;
+
+// Clear the semaphore table
+void sem_table_init();
+
+// Create a semaphore with an initial value, returns its id (or -1)
+int sem_create(int value);
+// Remove a semaphore, fails (-1) while processes are waiting on it
+int sem_destroy(int id);
+
+// Take one unit from a semaphore for p, returns 0 if p has been queued and must block (-1 for a bad id)
+int sem_take(int id, pcb_t* p);
+// Give one unit back to a semaphore, returns the waiter it was handed to (or NULL)
+pcb_t* sem_give(int id);
+
+#endif
@@ -0,0 +1,116 @@
+#include "shm.h"
+
+// Segment table, a segment with no page is unused
+shm_t shm_table[MAX_SHM];
+
+// Which segment (or -1) is attached in each shared memory slot of every process window
+int shm_attached[MAX_PROCS][VM_SHM_SLOTS];
+
+// Clear the segment and attachment tables
+void shm_init() {
+    memset(shm_table, 0, sizeof(shm_table));
+    for (int i = 0; i < MAX_PROCS; i++) {
+        for (int j = 0; j < VM_SHM_SLOTS; j++) {
+            shm_attached[i][j] = -1;
+        }
+    }
+}
+
+// Get the virtual address of a shared memory slot in a process window
+uint32_t shm_slot_addr(uint32_t slot, int i) {
+    return vm_window(slot) + VM_SHM_OFFSET + i * SECTION_SIZE;
+}
+
+// Create a new (zeroed) segment of at least size bytes for a process slot, returns its id
+int shm_create(uint32_t slot, uint32_t size) {
+    if (size == 0 || size > SECTION_SIZE) {
+        return -1;
+    }
+    // Find a free entry in the segment table
+    for (int id = 0; id < MAX_SHM; id++) {
+        if (shm_table[id].page == 0) {
+            uint32_t order = 0;
+            while ((PAGE_SIZE << order) < size) {
+                order++;
+            }
+            uint32_t page = alloc_pages(order);
+            if (page == 0) {
+                return -1;
+            }
+            memset((void*) page, 0, PAGE_SIZE << order);
+            shm_table[id] = (shm_t) {page, order, size, 0, slot};
+            return id;
+        }
+    }
+    return -1;
+}
+
+// Map a segment into a process's window, returns the address it was attached at
+uint32_t shm_attach(uint32_t slot, int id) {
+    if (id < 0 || id >= MAX_SHM || shm_table[id].page == 0) {
+        return 0;
+    }
+    shm_t* shm = &shm_table[id];
+
+    // Find a free shared memory slot in the window
+    for (int i = 0; i < VM_SHM_SLOTS; i++) {
+        if (shm_attached[slot][i] == -1) {
+            uint32_t addr = shm_slot_addr(slot, i);
+            for (int p = 0; p < (1 << shm->order); p++) {
+                if (!vm_map(addr + p * PAGE_SIZE, shm->page + p * PAGE_SIZE)) {
+                    // Undo a partial mapping
+                    for (int q = 0; q < p; q++) {
+                        vm_unmap(addr + q * PAGE_SIZE);
+                    }
+                    vm_unmap_range(addr, addr + SECTION_SIZE);
+                    return 0;
+                }
+            }
+            shm_attached[slot][i] = id;
+            shm->refs++;
+            return addr;
+        }
+    }
+    return 0;
+}
+
+// Unmap a segment from a process's window, freeing it if nobody else has it attached
+int shm_detach(uint32_t slot, uint32_t addr) {
+    for (int i = 0; i < VM_SHM_SLOTS; i++) {
+        if (shm_attached[slot][i] != -1 && shm_slot_addr(slot, i) == addr) {
+            shm_t* shm = &shm_table[shm_attached[slot][i]];
+
+            // Unmap the pages without freeing them, then drop the (now empty) table for the slot
+            for (int p = 0; p < (1 << shm->order); p++) {
+                vm_unmap(addr + p * PAGE_SIZE);
+            }
+            vm_unmap_range(addr, addr + SECTION_SIZE);
+            shm_attached[slot][i] = -1;
+
+            // Free the segment once the last process has detached
+            shm->refs--;
+            if (shm->refs == 0) {
+                free_pages(shm->page, shm->order);
+                shm->page = 0;
+            }
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Detach every segment a process slot still has attached, and free the ones it created that nobody has attached
+// -- A segment with no attachments is only ever freed by a detach, so without this one that was never attached would leak.
+void shm_release(uint32_t slot) {
+    for (int i = 0; i < VM_SHM_SLOTS; i++) {
+        if (shm_attached[slot][i] != -1) {
+            shm_detach(slot, shm_slot_addr(slot, i));
+        }
+    }
+    for (int id = 0; id < MAX_SHM; id++) {
+        if (shm_table[id].page != 0 && shm_table[id].refs == 0 && shm_table[id].creator == slot) {
+            free_pages(shm_table[id].page, shm_table[id].order);
+            shm_table[id].page = 0;
+        }
+    }
+}
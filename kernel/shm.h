@@ -0,0 +1,37 @@
+#ifndef __SHM_H
+#define __SHM_H
+
+// Standard definition includes
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Kernel memory and virtual memory
+#include "alloc.h"
+#include "vm.h"
+
+// Useful constants
+#define MAX_SHM (16)
+
+// Shared memory segment, backed by physically contiguous pages from the buddy allocator
+// -- creator is the process slot that made it, a segment nobody has attached is freed when its creator goes.
+typedef struct {
+    uint32_t page;
+    uint32_t order;
+    uint32_t size;
+    int refs;
+    uint32_t creator;
+} shm_t;
+
+// Clear the segment and attachment tables
+void shm_init();
+
+// Segment operations, all return -1 (or 0 for addresses) on failure
+int shm_create(uint32_t slot, uint32_t size);
+uint32_t shm_attach(uint32_t slot, int id);
+int shm_detach(uint32_t slot, uint32_t addr);
+
+// Detach every segment a process slot still has attached, and free the ones it created that nobody has attached
+void shm_release(uint32_t slot);
+
+#endif
@@ -0,0 +1,187 @@
+#include "swap.h"
+
+// Which swap slots on the disk are in use
+bool swap_used[SWAP_PAGES];
+
+// Virtual address of every pool page that holds a swappable user page (or 0)
+uint32_t frame_va[MAX_POOL_PAGES];
+
+// Clock hand, the next entry of the frame table to look at
+uint32_t clock_hand;
+
+// Counters, fault latency is kept in microseconds
+uint32_t swap_ins;
+uint32_t swap_outs;
+uint32_t resident_pages;
+uint32_t swapped_pages;
+uint32_t fault_us_total;
+uint32_t fault_us_max;
+
+// Clear the swap area and the frame table
+void swap_init() {
+    memset(swap_used, 0, sizeof(swap_used));
+    memset(frame_va, 0, sizeof(frame_va));
+    clock_hand = 0;
+    swap_ins = 0;
+    swap_outs = 0;
+    resident_pages = 0;
+    swapped_pages = 0;
+    fault_us_total = 0;
+    fault_us_max = 0;
+}
+
+
+/**********************************
+ * FRAME TABLE
+**********************************/
+
+// Get the frame table index of a pool page
+uint32_t frame_index(uint32_t page) {
+    return (page - (uint32_t) &pool_start) / PAGE_SIZE;
+}
+
+// Get the pool page of a frame table index
+uint32_t frame_page(uint32_t index) {
+    return (uint32_t) &pool_start + index * PAGE_SIZE;
+}
+
+// Remember that a user page is mapped at va and may be swapped out
+void swap_track(uint32_t va, uint32_t page) {
+    frame_va[frame_index(page)] = va;
+    resident_pages++;
+}
+
+// Forget a page, it has been unmapped
+void swap_untrack(uint32_t page) {
+    if (page < (uint32_t) &pool_start || page >= (uint32_t) &pool_end) {
+        return;
+    }
+    uint32_t index = frame_index(page);
+    if (frame_va[index] != 0) {
+        frame_va[index] = 0;
+        resident_pages--;
+    }
+}
+
+
+/**********************************
+ * SWAP SLOTS
+**********************************/
+
+// Find a free slot in the swap area (or -1)
+int swap_slot_alloc() {
+    for (int i = 0; i < SWAP_PAGES; i++) {
+        if (!swap_used[i]) {
+            swap_used[i] = true;
+            swapped_pages++;
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Give back a swap slot whose page is no longer needed
+void swap_slot_free(uint32_t slot) {
+    if (slot < SWAP_PAGES && swap_used[slot]) {
+        swap_used[slot] = false;
+        swapped_pages--;
+    }
+}
+
+
+/**********************************
+ * PAGE OUT AND PAGE IN
+**********************************/
+
+// Pick up to n cold pages with the clock (second chance) algorithm, returns how many were found
+// -- A page that has been used since the hand last passed gets aged instead and is kept for now.
+int swap_select(uint32_t* victims, int n) {
+    int found = 0;
+    // Two turns are enough, the first ages every page so the second must find cold ones
+    for (int i = 0; i < 2 * MAX_POOL_PAGES && found < n; i++) {
+        uint32_t va = frame_va[clock_hand];
+        if (va != 0 && !vm_age(va)) {
+            victims[found++] = clock_hand;
+        }
+        clock_hand = (clock_hand + 1) % MAX_POOL_PAGES;
+    }
+    mmu_flush();
+    return found;
+}
+
+// Write a batch of cold user pages out to the disk, returns how many pages were freed
+// -- Each page goes out as one pipelined run of disk writes, and the TLB is flushed once per batch.
+int swap_out() {
+    uint32_t victims[SWAP_BATCH];
+    int n = swap_select(victims, SWAP_BATCH);
+    int freed = 0;
+
+    for (int i = 0; i < n; i++) {
+        int slot = swap_slot_alloc();
+        if (slot == -1) {
+            break;
+        }
+        uint32_t page = frame_page(victims[i]);
+        if (disk_wr_many(SWAP_START + slot * SWAP_PAGE_SECTORS, (uint8_t*) page, SWAP_PAGE_SECTORS) < 0) {
+            swap_slot_free(slot);
+            continue;
+        }
+        // Leave the slot number in the page table so the next access can find the page again
+        vm_swap_entry(frame_va[victims[i]], slot);
+        swap_untrack(page);
+        free_pages(page, 0);
+        swap_outs++;
+        freed++;
+    }
+    mmu_flush();
+    return freed;
+}
+
+// Get a page for user memory, swapping others out first if memory is running low
+uint32_t swap_alloc_page() {
+    if (free_page_count() < SWAP_LOW_PAGES) {
+        swap_out();
+    }
+    uint32_t page = alloc_pages(0);
+    if (page == 0 && swap_out() > 0) {
+        page = alloc_pages(0);
+    }
+    return page;
+}
+
+// Read a swapped out page back in and map it at va, returns 0 on failure
+int swap_in(uint32_t va, uint32_t slot) {
+    uint32_t start = SYSCONF->COUNTER_24MHZ;
+
+    uint32_t page = swap_alloc_page();
+    if (page == 0) {
+        return 0;
+    }
+    if (disk_rd_many(SWAP_START + slot * SWAP_PAGE_SECTORS, (uint8_t*) page, SWAP_PAGE_SECTORS) < 0) {
+        free_pages(page, 0);
+        return 0;
+    }
+    vm_map_ap(va, page, L2_AP_RW);
+    swap_track(va, page);
+    swap_slot_free(slot);
+    swap_ins++;
+
+    // Time the whole fault, including any pages that had to be written out to make room
+    uint32_t us = (SYSCONF->COUNTER_24MHZ - start) / 24;
+    fault_us_total += us;
+    if (us > fault_us_max) {
+        fault_us_max = us;
+    }
+    return 1;
+}
+
+// Copy out the swap counters
+void swap_get_stats(swap_stat_t* stats) {
+    stats->swap_ins = swap_ins;
+    stats->swap_outs = swap_outs;
+    stats->resident = resident_pages;
+    stats->swapped = swapped_pages;
+    stats->free_pages = free_page_count();
+    stats->fault_us_total = fault_us_total;
+    stats->fault_us_max = fault_us_max;
+}
@@ -0,0 +1,56 @@
+#ifndef __SWAP_H
+#define __SWAP_H
+
+// Standard definition includes
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// System controller (for its 24MHz counter)
+#include "SYS.h"
+
+// Kernel memory, virtual memory and the disk layout
+#include "alloc.h"
+#include "vm.h"
+#include "file.h"
+
+// Swap area, it starts at the first sector past the filesystem
+#define SWAP_START (FS_SECTORS)
+#define SWAP_PAGES (256)
+#define SWAP_PAGE_SECTORS (PAGE_SIZE / SECTOR_LENGTH)
+
+// Pages written out per swap out, and the number of free pages below which swapping starts
+#define SWAP_BATCH (8)
+#define SWAP_LOW_PAGES (16)
+
+// Swap counters, as reported to user programs
+typedef struct {
+    uint32_t swap_ins;
+    uint32_t swap_outs;
+    uint32_t resident;
+    uint32_t swapped;
+    uint32_t free_pages;
+    uint32_t fault_us_total;
+    uint32_t fault_us_max;
+} swap_stat_t;
+
+// Clear the swap area and the frame table
+void swap_init();
+
+// Track which user pages can be swapped out
+void swap_track(uint32_t va, uint32_t page);
+void swap_untrack(uint32_t page);
+
+// Get a page for user memory, swapping others out first if memory is running low
+uint32_t swap_alloc_page();
+// Write a batch of cold user pages out to the disk, returns how many pages were freed
+int swap_out();
+// Read a swapped out page back in and map it at va, returns 0 on failure
+int swap_in(uint32_t va, uint32_t slot);
+// Give back a swap slot whose page is no longer needed
+void swap_slot_free(uint32_t slot);
+
+// Copy out the swap counters
+void swap_get_stats(swap_stat_t* stats);
+
+#endif
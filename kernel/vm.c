@@ -0,0 +1,359 @@
+#include "vm.h"
+#include "swap.h"
+
+// First level page table
+// -- One entry per 1 MiB of virtual memory, everything outside of the process windows is identity mapped.
+uint32_t l1_table[4096] __attribute__((aligned(0x4000)));
+
+// Cache of second level page tables, used for the sections of the process windows that are in use
+kmem_cache_t* pgtable_cache;
+
+// Current heap break per process slot
+uint32_t heap_brk[MAX_PROCS];
+
+
+/**********************************
+ * PAGE TABLES
+**********************************/
+
+// Set up the page tables and turn on the MMU
+void vm_init() {
+    // Identity map the whole address space using 1 MiB sections
+    for (int i = 0; i < 4096; i++) {
+        l1_table[i] = (i << 20) | L1_AP_RW | L1_SECTION;
+    }
+
+    // Unmap the process windows, second level tables are added as they are used
+    for (int slot = 0; slot < MAX_PROCS; slot++) {
+        uint32_t window = vm_window(slot);
+        for (uint32_t va = window; va < window + VM_WINDOW; va += SECTION_SIZE) {
+            l1_table[va >> 20] = L1_FAULT;
+        }
+        heap_brk[slot] = window + VM_HEAP_OFFSET;
+    }
+
+    // Keep a table for every process's stack in reserve
+    pgtable_cache = cache_create("pgtable", L2_TABLE_SIZE, MAX_PROCS);
+
+    // Point the MMU at our table, use domain 0 as a client (permissions are checked) and enable it
+    mmu_set_ptr0(l1_table);
+    mmu_set_dom(0, 0x1);
+    mmu_flush();
+    mmu_enable();
+}
+
+// Get the base address of a process slot's window
+uint32_t vm_window(uint32_t slot) {
+    return VM_BASE + slot * VM_WINDOW;
+}
+
+// Map a physical page at a virtual address, a page of 0 maps a fresh zeroed page
+int vm_map(uint32_t va, uint32_t page) {
+    return vm_map_ap(va, page, L2_AP_RW);
+}
+
+// Map a physical page at a virtual address with the given access permissions
+int vm_map_ap(uint32_t va, uint32_t page, uint32_t ap) {
+    // Find the second level table, creating it if this section has not been used yet
+    uint32_t* entry = &l1_table[va >> 20];
+    if (*entry == L1_FAULT) {
+        uint32_t* table = cache_alloc(pgtable_cache);
+        if (table == NULL) {
+            return 0;
+        }
+        memset(table, 0, L2_TABLE_SIZE);
+        *entry = ((uint32_t) table) | L1_COARSE;
+    }
+    uint32_t* table = (uint32_t*) (*entry & ~(L2_TABLE_SIZE - 1));
+
+    // Get a page to map if we were not given one, such pages belong to the process alone and can be swapped out
+    if (page == 0) {
+        page = swap_alloc_page();
+        if (page == 0) {
+            return 0;
+        }
+        memset((void*) page, 0, PAGE_SIZE);
+        swap_track(va, page);
+    }
+    table[(va >> 12) & 0xFF] = page | ap | L2_SMALL;
+    return 1;
+}
+
+// Get the second level entry for a virtual address inside a process window (or L2_FAULT)
+uint32_t vm_lookup(uint32_t va) {
+    uint32_t entry = l1_table[va >> 20];
+    if (entry == L1_FAULT) {
+        return L2_FAULT;
+    }
+    return ((uint32_t*) (entry & ~(L2_TABLE_SIZE - 1)))[(va >> 12) & 0xFF];
+}
+
+// Change the access permissions of a mapped page
+void vm_protect(uint32_t va, uint32_t ap) {
+    uint32_t entry = l1_table[va >> 20];
+    if (entry == L1_FAULT) {
+        return;
+    }
+    uint32_t* table = (uint32_t*) (entry & ~(L2_TABLE_SIZE - 1));
+    if (table[(va >> 12) & 0xFF] & L2_SMALL) {
+        table[(va >> 12) & 0xFF] = (table[(va >> 12) & 0xFF] & ~L2_AP_MASK) | ap;
+        mmu_flush();
+    }
+}
+
+// Unmap a virtual address, returning the physical page that was there (or 0)
+uint32_t vm_unmap(uint32_t va) {
+    uint32_t entry = l1_table[va >> 20];
+    if (entry == L1_FAULT) {
+        return 0;
+    }
+    uint32_t* table = (uint32_t*) (entry & ~(L2_TABLE_SIZE - 1));
+    uint32_t page = table[(va >> 12) & 0xFF];
+    if (page == L2_FAULT) {
+        return 0;
+    }
+    table[(va >> 12) & 0xFF] = L2_FAULT;
+
+    // A swapped out page only holds on to its swap slot
+    if (page & L2_SWAPPED) {
+        swap_slot_free(page >> 12);
+        return 0;
+    }
+    mmu_flush();
+    swap_untrack(page & ~(PAGE_SIZE - 1));
+    return page & ~(PAGE_SIZE - 1);
+}
+
+// Unmap and free every page in a page aligned range, dropping tables for whole sections
+void vm_unmap_range(uint32_t start, uint32_t end) {
+    for (uint32_t va = start; va < end; va += PAGE_SIZE) {
+        uint32_t page = vm_unmap(va);
+        if (page != 0) {
+            free_pages(page, 0);
+        }
+        // Give back the table once the range has covered all of its section
+        uint32_t section = va & ~(SECTION_SIZE - 1);
+        if (va + PAGE_SIZE == section + SECTION_SIZE && start <= section && l1_table[va >> 20] != L1_FAULT) {
+            cache_free(pgtable_cache, (void*) (l1_table[va >> 20] & ~(L2_TABLE_SIZE - 1)));
+            l1_table[va >> 20] = L1_FAULT;
+        }
+    }
+    mmu_flush();
+}
+
+// Test and clear whether a mapped page has been used, returns 1 if it had been
+// -- Clearing makes the page inaccessible, so the next use faults and vm_fault marks it used again.
+// -- The caller has to flush the TLB.
+int vm_age(uint32_t va) {
+    uint32_t* table = (uint32_t*) (l1_table[va >> 20] & ~(L2_TABLE_SIZE - 1));
+    uint32_t* entry = &table[(va >> 12) & 0xFF];
+    if ((*entry & L2_AP_MASK) == L2_AP_NONE) {
+        return 0;
+    }
+    *entry = (*entry & ~L2_AP_MASK) | L2_AP_NONE;
+    return 1;
+}
+
+// Replace the mapping at va with the swap slot its page was written to, returns the page
+// -- The caller has to flush the TLB.
+uint32_t vm_swap_entry(uint32_t va, uint32_t slot) {
+    uint32_t* table = (uint32_t*) (l1_table[va >> 20] & ~(L2_TABLE_SIZE - 1));
+    uint32_t page = table[(va >> 12) & 0xFF] & ~(PAGE_SIZE - 1);
+    table[(va >> 12) & 0xFF] = (slot << 12) | L2_SWAPPED;
+    return page;
+}
+
+
+/**********************************
+ * PROCESS STACKS
+**********************************/
+
+// Get the top of the stack for a given process slot
+uint32_t vm_stack_top(uint32_t slot) {
+    return vm_window(slot) + VM_WINDOW;
+}
+
+// Back a single stack page with a fresh physical page, painted so its use can be measured later
+int map_stack_page(uint32_t slot, uint32_t va) {
+    if (!vm_map(va, 0)) {
+        return 0;
+    }
+    uint32_t* page = (uint32_t*) (vm_lookup(va) & ~(PAGE_SIZE - 1));
+    stack_paint(page, page + PAGE_SIZE / sizeof(uint32_t));
+    return 1;
+}
+
+// Make sure every page between sp and the top of the stack is mapped
+void vm_stack_reserve(uint32_t slot, uint32_t sp) {
+    for (uint32_t va = sp & ~(PAGE_SIZE - 1); va < vm_stack_top(slot); va += PAGE_SIZE) {
+        if (vm_lookup(va) == L2_FAULT) {
+            map_stack_page(slot, va);
+        }
+    }
+}
+
+// Unmap a process's stack and give its pages back to the pool
+void vm_stack_release(uint32_t slot) {
+    vm_unmap_range(vm_window(slot) + VM_STACK_OFFSET, vm_stack_top(slot));
+}
+
+// Peak stack usage (in bytes) of the process in the given slot
+// -- Found from the deepest word that no longer holds paint, a swapped out page counts as fully used.
+uint32_t vm_stack_peak(uint32_t slot) {
+    uint32_t top = vm_stack_top(slot);
+    for (uint32_t va = vm_window(slot) + VM_STACK_OFFSET + PAGE_SIZE; va < top; va += PAGE_SIZE) {
+        uint32_t entry = vm_lookup(va);
+        if (entry == L2_FAULT) {
+            continue;
+        }
+        if (!(entry & L2_SMALL)) {
+            return top - va;
+        }
+        uint32_t* page = (uint32_t*) (entry & ~(PAGE_SIZE - 1));
+        return top - va - stack_unused(page, page + PAGE_SIZE / sizeof(uint32_t));
+    }
+    return 0;
+}
+
+// Fill an unused stack area with paint
+void stack_paint(uint32_t* bottom, uint32_t* top) {
+    for (uint32_t* word = bottom; word < top; word++) {
+        *word = STACK_PAINT;
+    }
+}
+
+// Count the bytes at the bottom of a stack area that still hold paint
+uint32_t stack_unused(uint32_t* bottom, uint32_t* top) {
+    uint32_t* word = bottom;
+    while (word < top && *word == STACK_PAINT) {
+        word++;
+    }
+    return (word - bottom) * sizeof(uint32_t);
+}
+
+
+/**********************************
+ * PROCESS HEAPS
+**********************************/
+
+// Move the heap break of a process, returns the old break (or 0 if the heap cannot be moved)
+uint32_t vm_sbrk(uint32_t slot, int increment) {
+    uint32_t window = vm_window(slot);
+    uint32_t old = heap_brk[slot];
+    uint32_t new = old + increment;
+    if (new < window + VM_HEAP_OFFSET || new > window + VM_HEAP_END) {
+        return 0;
+    }
+
+    // Pages are mapped on first touch, but any wholly above a shrunk break are given back now
+    if (new < old) {
+        uint32_t first = (new + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+        for (uint32_t va = first; va < old; va += PAGE_SIZE) {
+            uint32_t page = vm_unmap(va);
+            if (page != 0) {
+                free_pages(page, 0);
+            }
+        }
+    }
+    heap_brk[slot] = new;
+    return old;
+}
+
+// Unmap a process's heap (and local page) and give its pages back to the pool
+void vm_heap_release(uint32_t slot) {
+    vm_unmap_range(vm_window(slot), vm_window(slot) + VM_HEAP_END);
+    heap_brk[slot] = vm_window(slot) + VM_HEAP_OFFSET;
+}
+
+
+/**********************************
+ * FORKING
+**********************************/
+
+// Check whether an address is in a part of a window that fork copies, the local page and heap or the stack from sp up
+bool fork_copied(uint32_t slot, uint32_t sp, uint32_t addr) {
+    return (addr >= vm_window(slot) && addr < heap_brk[slot]) || (addr >= sp && addr < vm_stack_top(slot));
+}
+
+// Copy the words in [start, end) of one window to the same place in another
+// -- A word pointing into a copied part of the old window is moved by the distance between the windows, like what it points at.
+void fork_words(uint32_t from, uint32_t to, uint32_t sp, uint32_t start, uint32_t end) {
+    uint32_t delta = vm_window(to) - vm_window(from);
+    for (uint32_t* src = (uint32_t*) start; (uint32_t) src < end; src++) {
+        *(uint32_t*) ((uint32_t) src + delta) = fork_copied(from, sp, *src) ? *src + delta : *src;
+    }
+}
+
+// Give the process in slot to a copy of the local page, heap and stack (from sp up) of the process in slot from
+// -- Only pages the parent has touched are copied, the child's other heap pages are mapped on first touch as usual.
+// -- regs are the child's registers, moved across like the words copied. Returns 0 (or -1 if memory ran out).
+int vm_fork(uint32_t from, uint32_t to, uint32_t sp, uint32_t* regs, int nregs) {
+    uint32_t delta = vm_window(to) - vm_window(from);
+    for (uint32_t va = vm_window(from); va < heap_brk[from]; va += PAGE_SIZE) {
+        if (vm_lookup(va) == L2_FAULT) {
+            continue;
+        }
+        if (!vm_map(va + delta, 0)) {
+            return -1;
+        }
+        uint32_t end = va + PAGE_SIZE < heap_brk[from] ? va + PAGE_SIZE : heap_brk[from];
+        fork_words(from, to, sp, va, end);
+    }
+    heap_brk[to] = heap_brk[from] + delta;
+
+    for (uint32_t va = sp & ~(PAGE_SIZE - 1); va < vm_stack_top(from); va += PAGE_SIZE) {
+        if (vm_lookup(va + delta) == L2_FAULT && !map_stack_page(to, va + delta)) {
+            return -1;
+        }
+    }
+    fork_words(from, to, sp, sp, vm_stack_top(from));
+
+    for (int i = 0; i < nregs; i++) {
+        if (fork_copied(from, sp, regs[i])) {
+            regs[i] += delta;
+        }
+    }
+    return 0;
+}
+
+
+/**********************************
+ * FAULT HANDLING
+**********************************/
+
+// Handle a data abort at a given address, returns 0 if it could not be resolved
+int vm_fault(uint32_t addr, uint32_t status) {
+    // Check the address is inside one of the process windows
+    if (addr < VM_BASE || addr >= VM_BASE + MAX_PROCS * VM_WINDOW) {
+        return 0;
+    }
+    uint32_t slot = (addr - VM_BASE) / VM_WINDOW;
+    uint32_t offset = (addr - VM_BASE) % VM_WINDOW;
+    uint32_t va = addr & ~(PAGE_SIZE - 1);
+    uint32_t entry = vm_lookup(va);
+
+    // A page aged by the swap clock has been used again
+    if (status == FAULT_PERMISSION_PAGE && (entry & L2_SMALL) && (entry & L2_AP_MASK) == L2_AP_NONE) {
+        vm_protect(va, L2_AP_RW);
+        return 1;
+    }
+    // Bring back a page that was swapped out
+    if (status == FAULT_TRANSLATION_PAGE && (entry & L2_SWAPPED)) {
+        return swap_in(va, entry >> 12);
+    }
+
+    // Otherwise only missing pages can be fixed up
+    if (status != FAULT_TRANSLATION_PAGE && status != FAULT_TRANSLATION_SECTION) {
+        return 0;
+    }
+
+    // Grow the stack, unless the guard page (or something below it) was hit
+    if (offset >= VM_STACK_OFFSET + PAGE_SIZE) {
+        return map_stack_page(slot, va);
+    }
+    // Map the local page, or a heap page below the break
+    if (offset < VM_HEAP_OFFSET || addr < heap_brk[slot]) {
+        return vm_map(va, 0);
+    }
+    return 0;
+}
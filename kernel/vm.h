@@ -0,0 +1,99 @@
+#ifndef __VM_H
+#define __VM_H
+
+// Standard definition includes
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// MMU driver
+#include "MMU.h"
+
+// Kernel memory and process definitions
+#include "alloc.h"
+#include "process.h"
+
+// Useful constants
+#define SECTION_SIZE (0x100000)
+
+#define L2_TABLE_SIZE (0x400)
+
+// Virtual memory layout
+// -- Each process slot owns a 16 MiB window starting at VM_BASE.
+// -- The first page of a window is private to the process's user code (e.g. its allocator state).
+// -- The heap follows it and can grow (via sbrk) up to VM_HEAP_END.
+// -- Shared memory segments are attached in 1 MiB slots between VM_SHM_OFFSET and VM_SHM_END.
+// -- Memory mapped files get 1 MiB slots between VM_MMAP_OFFSET and the stack.
+// -- The top 1 MiB of a window is the process's stack, its lowest page is never mapped (guard page).
+#define VM_BASE (0xA0000000)
+#define VM_WINDOW (0x1000000)
+#define VM_LOCAL_OFFSET (0x0)
+#define VM_HEAP_OFFSET (PAGE_SIZE)
+#define VM_HEAP_END (0x800000)
+#define VM_SHM_OFFSET (0x800000)
+#define VM_SHM_END (0xC00000)
+#define VM_SHM_SLOTS ((VM_SHM_END - VM_SHM_OFFSET) / SECTION_SIZE)
+#define VM_MMAP_OFFSET (0xC00000)
+#define VM_MMAP_SLOTS ((VM_STACK_OFFSET - VM_MMAP_OFFSET) / SECTION_SIZE)
+#define VM_STACK_OFFSET (VM_WINDOW - SECTION_SIZE)
+#define VM_STACK_PAGES (SECTION_SIZE / PAGE_SIZE)
+
+// Pattern unused stack memory is painted with, so the deepest use can be found
+#define STACK_PAINT (0xDEADBEEF)
+
+// Page table descriptor bits (ARMv7 short-descriptor format, domain 0)
+#define L1_FAULT (0x0)
+#define L1_COARSE (0x1)
+#define L1_SECTION (0x2)
+#define L1_AP_RW (0x3 << 10)
+#define L2_FAULT (0x0)
+#define L2_SMALL (0x2)
+#define L2_AP_RW (0x3 << 4)
+#define L2_AP_RO (0x2 << 4)
+#define L2_AP_NONE (0x0 << 4)
+#define L2_AP_MASK (0x3 << 4)
+
+// Page table entry of a swapped out page, it faults like an empty entry but keeps the swap slot in bits 31:12
+#define L2_SWAPPED (0x4)
+
+// Data fault status codes
+#define FAULT_TRANSLATION_SECTION (0x05)
+#define FAULT_TRANSLATION_PAGE (0x07)
+#define FAULT_PERMISSION_PAGE (0x0F)
+
+// Set up the page tables and turn on the MMU
+void vm_init();
+
+// Page mapping
+uint32_t vm_window(uint32_t slot);
+int vm_map(uint32_t va, uint32_t page);
+int vm_map_ap(uint32_t va, uint32_t page, uint32_t ap);
+uint32_t vm_lookup(uint32_t va);
+void vm_protect(uint32_t va, uint32_t ap);
+uint32_t vm_unmap(uint32_t va);
+void vm_unmap_range(uint32_t start, uint32_t end);
+
+// Swapping support
+int vm_age(uint32_t va);
+uint32_t vm_swap_entry(uint32_t va, uint32_t slot);
+
+// Process stack management
+uint32_t vm_stack_top(uint32_t slot);
+void vm_stack_reserve(uint32_t slot, uint32_t sp);
+void vm_stack_release(uint32_t slot);
+uint32_t vm_stack_peak(uint32_t slot);
+void stack_paint(uint32_t* bottom, uint32_t* top);
+uint32_t stack_unused(uint32_t* bottom, uint32_t* top);
+
+// Process heap management
+uint32_t vm_sbrk(uint32_t slot, int increment);
+void vm_heap_release(uint32_t slot);
+
+// Copy a parent's local page, heap and stack into a forked child's window, returns 0 (or -1)
+int vm_fork(uint32_t from, uint32_t to, uint32_t sp, uint32_t* regs, int nregs);
+
+// Handle a data abort at a given address, returns 0 if it could not be resolved
+int vm_fault(uint32_t addr, uint32_t status);
+
+#endif
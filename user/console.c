@@ -1,8 +1,9 @@
 #include "console.h"
 
+// Read a line from STDIN, sleeping in the kernel while no input has arrived
 void gets(char* x, int n) {
     for (int i = 0; i < n; i++) {
-        x[i] = PL011_getc(UART1, true);  
+        read(STDIN_FILENO, &x[i], 1);
         if (x[i] == '\x0A') {
             x[i] = '\x00';
             break;
@@ -19,11 +20,78 @@ void* loader(char* x) {
         return &main_P5;
     } else if (0 == strcmp(x, "Dining")) {
         return &main_dining;
+    } else if (0 == strcmp(x, "Pipeline")) {
+        return &main_pipeline;
+    } else if (0 == strcmp(x, "Seq")) {
+        return &main_seq;
+    } else if (0 == strcmp(x, "Wc")) {
+        return &main_wc;
+    } else if (0 == strcmp(x, "Inversion")) {
+        return &main_inversion;
+    } else if (0 == strcmp(x, "SyncBench")) {
+        return &main_syncbench;
+    } else if (0 == strcmp(x, "Mq")) {
+        return &main_mq;
+    } else if (0 == strcmp(x, "IpcBench")) {
+        return &main_ipcbench;
+    } else if (0 == strcmp(x, "Watch")) {
+        return &main_watch;
+    } else if (0 == strcmp(x, "LockFree")) {
+        return &main_lockfree;
+    } else if (0 == strcmp(x, "FileBench")) {
+        return &main_filebench;
+    } else if (0 == strcmp(x, "PathBench")) {
+        return &main_pathbench;
     } else {
         return NULL;
     }
 }
 
+// Print the programs the loader knows about
+void print_programs() {
+    print("List of available user programs: \n");
+    print("\tP3 - Looping program that does basic bit arithmetic on some numbers\n");
+    print("\tP4 - Looping program that calculates the gcd of some numbers, includes recursion\n");
+    print("\tP5 - Terminating program that calculates which numbers are prime betweem to values\n");
+    print("\tDining - dining philosophers example program\n");
+    print("\tPipeline - producer/consumer passing buffers through shared memory\n");
+    print("\tSeq - prints the numbers 1 to 200, one per line\n");
+    print("\tWc - counts the lines and bytes on its input\n");
+    print("\tInversion - low priority lock holder inheriting the priority of its waiter\n");
+    print("\tSyncBench - times barrier round trips and reader-writer lock throughput for 1 to 8 workers\n");
+    print("\tMq - producers passing prioritised jobs to a consumer through a message queue\n");
+    print("\tIpcBench - times synchronous send/receive/reply round trips against a semaphore handoff\n");
+    print("\tWatch - polls two pipes and STDIN from one process\n");
+    print("\tLockFree - stress tests and times the lock-free queues and stack\n");
+    print("\tFileBench - times writing, syncing and reading back files of up to 512 KiB\n");
+    print("\tPathBench - times repeated opens of a file six levels down, with the path cache counters\n");
+}
+
+// Run program a with its output piped into program b
+void run_pipe(void* a, void* b) {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        print("Could not create pipe\n");
+        return;
+    }
+    if (fork() == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        exec(a);
+    }
+    if (fork() == 0) {
+        dup2(fds[0], STDIN_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        exec(b);
+    }
+    // Only the children may hold the ends, or the reader would never see end-of-file
+    close(fds[0]);
+    close(fds[1]);
+}
+
 char cwd[1024];
 void main_console() {
     strcpy(cwd, "/");
@@ -51,14 +119,33 @@ void main_console() {
                 print("\tlist - list all currently running processes\n");
                 print("\ttouch {FILEPATH} - creates a file at the given path\n");
                 print("\tcat {FILEPATH} - prints contents of file\n");
-                print("\tconcat {FILEPATH} {WORD} - writes a word to file\n");
+                print("\tconcat {FILEPATH} {WORD} - appends a word to file\n");
                 print("\trm {FILEPATH} - deletes a file from disk\n");
                 print("\tmkdir {DIRPATH} - creates a new directory at the specified path\n");
                 print("\trmdir {DIRPATH} - deletes an empty directory from disk\n");
                 print("\tcd {DIRPATH} - change the current directory\n");
                 print("\tls {DIRPATH} - prints the contents of the given directory\n");
+                print("\t{PROGRAM} | {PROGRAM} - execute two user processes, piping the first's output into the second\n");
+                print("\tswap - prints paging and swap counters\n");
+                print("\tmem - prints kernel heap callsites, cache usage and stack high-water marks\n");
+                print("\tlocks - prints kernel mutex contention and priority inversion counters\n");
+                print("\tsync - writes modified filesystem blocks back to the disk\n");
+                print("\tbcache - prints filesystem block cache counters\n");
+                print("\tdcache - prints path lookup cache counters\n");
             } else if (strcmp(cmd_argv[0], "list") == 0) {
                 list_procs();
+            } else if (strcmp(cmd_argv[0], "swap") == 0) {
+                print_swap_stats();
+            } else if (strcmp(cmd_argv[0], "mem") == 0) {
+                print_mem_stats();
+            } else if (strcmp(cmd_argv[0], "locks") == 0) {
+                print_lock_stats();
+            } else if (strcmp(cmd_argv[0], "sync") == 0) {
+                sync();
+            } else if (strcmp(cmd_argv[0], "bcache") == 0) {
+                print_bcache_stats();
+            } else if (strcmp(cmd_argv[0], "dcache") == 0) {
+                print_dcache_stats();
             } else if (strcmp(cmd_argv[0], "ls") == 0) {
                 listdir("");
             } else {
@@ -70,15 +157,13 @@ void main_console() {
                 void* addr = loader(cmd_argv[1]);
                 if (addr != NULL) {
                     if (fork() == 0) {
+                        // Programs write to stdout rather than the console's own output
+                        dup2(STDERR_FILENO, STDOUT_FILENO);
                         exec(addr);
                     }
                 } else {
                     print("Unknown program\n");
-                    print("List of available user programs: \n");
-                    print("\tP3 - Looping program that does basic bit arithmetic on some numbers\n");
-                    print("\tP4 - Looping program that calculates the gcd of some numbers, includes recursion\n");
-                    print("\tP5 - Terminating program that calculates which numbers are prime betweem to values\n");
-                    print("\tDining - dining philosophers example program\n");
+                    print_programs();
                 }
             } else if (strcmp(cmd_argv[0], "kill") == 0) {
                 kill(atoi(cmd_argv[1]), SIG_TERM);
@@ -86,11 +171,14 @@ void main_console() {
                 int file = open(cmd_argv[1]);
                 close(file);
             } else if (strcmp(cmd_argv[0], "cat") == 0) {
-                int file = open(cmd_argv[1]);
+                int file = open_mode(cmd_argv[1], O_READ);
                 char txt[16];
-                read(file, &txt, 15);
+                int n;
+                while ((n = read(file, &txt, 15)) > 0) {
+                    txt[n] = '\0';
+                    print(txt);
+                }
                 close(file);
-                print(txt);
                 print("\n");
             } else if (strcmp(cmd_argv[0], "rm") == 0) {
                 remove(cmd_argv[1]);
@@ -100,7 +188,7 @@ void main_console() {
                 rmdir(cmd_argv[1]);
             } else if (strcmp(cmd_argv[0], "cd") == 0) {
                 chdir(cmd_argv[1]);
-                strcpy(cwd, getcwd());
+                getcwd(cwd, sizeof(cwd));
             } else if (strcmp(cmd_argv[0], "ls") == 0) {
                 listdir(cmd_argv[1]);
             } else {
@@ -109,9 +197,18 @@ void main_console() {
             }
         } else {
             if (strcmp(cmd_argv[0], "concat") == 0) {
-                int file = open(cmd_argv[1]);
-                write(file, cmd_argv[2], strlen(cmd_argv[2]) + 1);
+                int file = open_mode(cmd_argv[1], O_APPEND);
+                write(file, cmd_argv[2], strlen(cmd_argv[2]));
                 close(file);
+            } else if (strcmp(cmd_argv[1], "|") == 0) {
+                void* a = loader(cmd_argv[0]);
+                void* b = loader(cmd_argv[2]);
+                if (a != NULL && b != NULL) {
+                    run_pipe(a, b);
+                } else {
+                    print("Unknown program\n");
+                    print_programs();
+                }
             } else {
                 print("Unknown command\n");
                 print("Enter 'help' for a list of commands\n");
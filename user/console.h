@@ -16,5 +16,16 @@ extern void main_P3();
 extern void main_P4(); 
 extern void main_P5(); 
 extern void main_dining();
+extern void main_pipeline();
+extern void main_seq();
+extern void main_wc();
+extern void main_inversion();
+extern void main_syncbench();
+extern void main_mq();
+extern void main_ipcbench();
+extern void main_watch();
+extern void main_lockfree();
+extern void main_filebench();
+extern void main_pathbench();
 
 #endif
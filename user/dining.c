@@ -3,7 +3,8 @@
 // How many philosophers do we want
 #define PHILOSOPHERS (16)
 
-uint32_t* forks[PHILOSOPHERS];
+// Forks are futex-based mutexes, globals are shared by every process so the philosophers can use them directly
+mutex_t forks[PHILOSOPHERS];
 
 void philosopher(int id) {
     while(1) {
@@ -11,11 +12,11 @@ void philosopher(int id) {
         for (volatile int i = 0; i < rand() % 100000; i++) {}
 
         if (id % 2 == 0) {
-            sem_wait(forks[id]);
-            sem_wait(forks[(id + 1) % PHILOSOPHERS]);
+            mutex_lock(&forks[id]);
+            mutex_lock(&forks[(id + 1) % PHILOSOPHERS]);
         } else {
-            sem_wait(forks[(id + 1) % PHILOSOPHERS]);
-            sem_wait(forks[id]);
+            mutex_lock(&forks[(id + 1) % PHILOSOPHERS]);
+            mutex_lock(&forks[id]);
         }
 
         // Eat for a random amount of time
@@ -23,15 +24,15 @@ void philosopher(int id) {
         print(" is eating\n");
         for (volatile int i = 0; i < rand() % 100000; i++) {}
 
-        sem_post(forks[id]);
-        sem_post(forks[(id + 1) % PHILOSOPHERS]);
+        mutex_unlock(&forks[id]);
+        mutex_unlock(&forks[(id + 1) % PHILOSOPHERS]);
     }
 }
 
 // Main function, responsible for setup of the semaphores and philosopher processes
 void main_dining() {
     for (int i = 0; i < PHILOSOPHERS; i++) {
-        forks[i] = sem_init(1);
+        mutex_init(&forks[i]);
     }
     for (int i = 0; i < PHILOSOPHERS; i++) {
         if (0 == fork()) {
@@ -0,0 +1,117 @@
+#include "libc.h"
+
+// Number of file sizes tried, and extra bytes asked for when reading back (past the end of the file)
+#define RUNS (4)
+#define BENCH_SLACK (100)
+// Records written one at a time to a file opened for appending, and how big each one is
+#define APPENDS (512)
+#define RECORD (32)
+// Descriptors held open on one file at the same time, well past the size a descriptor table starts at
+#define OPENS (300)
+
+// File sizes tried, with 512 byte blocks the larger ones go through the double indirect block
+const uint32_t bench_sizes[RUNS] = {4096, 65536, 262144, 524288};
+
+// Print a transfer rate in KiB per second
+void print_rate(const char* what, uint32_t bytes, uint32_t ticks) {
+    uint32_t us = ticks / CLOCK_TICKS_PER_US;
+    print(what);
+    printI(us == 0 ? 0 : (uint32_t) ((uint64_t) bytes * 1000000 / 1024 / us));
+    print(" KiB/s");
+}
+
+// Main function, writes, syncs and reads back files from a few KiB up to half a MiB, checking what comes back
+void main_filebench() {
+    uint8_t* out = malloc(bench_sizes[RUNS - 1]);
+    uint8_t* in = malloc(bench_sizes[RUNS - 1] + BENCH_SLACK);
+    if (out == NULL || in == NULL) {
+        print("Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int r = 0; r < RUNS; r++) {
+        uint32_t size = bench_sizes[r];
+        for (uint32_t i = 0; i < size; i++) {
+            out[i] = (uint8_t) (i * 7 + r);
+        }
+        int fd = open("bench.dat");
+
+        uint32_t t0 = clock_ticks();
+        int written = write(fd, out, size);
+        uint32_t t1 = clock_ticks();
+        sync();
+        uint32_t t2 = clock_ticks();
+        // Ask for more than the file holds, the read should stop at the end of the file
+        lseek(fd, 0, SEEK_SET);
+        int got = read(fd, in, size + BENCH_SLACK);
+        uint32_t t3 = clock_ticks();
+
+        printI(size / 1024);
+        print(" KiB: ");
+        print_rate("write ", size, t1 - t0);
+        print_rate(", sync ", size, t2 - t1);
+        print_rate(", read ", size, t3 - t2);
+        if (written != size || got != size || memcmp(in, out, size) != 0) {
+            print(" MISMATCH");
+        }
+        print("\n");
+
+        close(fd);
+        remove("bench.dat");
+    }
+
+    // Small appends only touch the last block, then check a record in the middle without moving the offset
+    int fd = open_mode("bench.log", O_APPEND);
+    uint32_t t0 = clock_ticks();
+    for (int i = 0; i < APPENDS; i++) {
+        memset(out, 'a' + i % 26, RECORD);
+        write(fd, out, RECORD);
+    }
+    uint32_t us = (clock_ticks() - t0) / CLOCK_TICKS_PER_US;
+    print("Appends of ");
+    printI(RECORD);
+    print(" bytes: (us) ");
+    printI(us / APPENDS);
+    int i = APPENDS / 2 + 3;
+    if (lseek(fd, 0, SEEK_END) != APPENDS * RECORD || pread(fd, in, RECORD, i * RECORD) != RECORD || in[0] != 'a' + i % 26) {
+        print(" MISMATCH");
+    }
+    print("\n");
+    close(fd);
+    remove("bench.log");
+
+    // Hold a file open many times over, reading through every descriptor, then remove it while the last one is still open
+    int* fds = malloc(OPENS * sizeof(int));
+    fd = open("bench.fds");
+    write(fd, "fds!", 4);
+    close(fd);
+    bool ok = fds != NULL;
+    t0 = clock_ticks();
+    for (i = 0; ok && i < OPENS; i++) {
+        fds[i] = open_mode("bench.fds", O_READ);
+        ok = fds[i] >= 0 && pread(fds[i], in, 4, 0) == 4 && memcmp(in, "fds!", 4) == 0;
+    }
+    us = (clock_ticks() - t0) / CLOCK_TICKS_PER_US;
+    print("Opens held at once: ");
+    printI(i);
+    print(", open and read (us) ");
+    printI(i == 0 ? 0 : us / i);
+    int n = i;
+    for (i = 0; i < n - 1; i++) {
+        close(fds[i]);
+    }
+    remove("bench.fds");
+    if (!ok || n == 0 || read(fds[n - 1], in, 4) != 4 || memcmp(in, "fds!", 4) != 0) {
+        print(" MISMATCH");
+    }
+    print("\n");
+    if (n > 0) {
+        close(fds[n - 1]);
+    }
+    free(fds);
+
+    free(out);
+    free(in);
+    print_bcache_stats();
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,68 @@
+#include "libc.h"
+
+// Number of CPU bound processes competing with the lock holder, and how long everyone spins for
+#define HOGS (2)
+#define SPIN (2000000)
+
+// Kernel mutex and condition variable ids, and whether the holder has the lock yet (globals are shared by every process)
+int lock;
+int held_cond;
+volatile int held;
+
+// Burn CPU time, so the scheduler moves the process down to the lowest level
+void spin() {
+    for (volatile int i = 0; i < SPIN; i++) {}
+}
+
+// Low priority process, takes the lock and works while holding it
+void holder() {
+    kmutex_lock(lock);
+    held = 1;
+    cond_signal(held_cond);
+    print("Holder has the lock\n");
+    spin();
+    print("Holder releases the lock\n");
+    kmutex_unlock(lock);
+    exit(EXIT_SUCCESS);
+}
+
+// Medium priority processes, keep the CPU busy so the holder would starve without inheritance
+void hog() {
+    spin();
+    spin();
+    exit(EXIT_SUCCESS);
+}
+
+// Main function, starts a low priority holder and medium priority hogs, then waits for the lock the holder takes
+void main_inversion() {
+    lock = kmutex_init();
+    held_cond = cond_init();
+    held = 0;
+
+    // Keep the lock until everything is running, so the holder queues for it
+    kmutex_lock(lock);
+    int pid = fork();
+    if (pid == 0) {
+        holder();
+    }
+    nice(pid, 0);
+    for (int i = 0; i < HOGS; i++) {
+        pid = fork();
+        if (pid == 0) {
+            hog();
+        }
+        nice(pid, 1);
+    }
+
+    // Waiting releases the lock to the holder, once signalled we queue for it again and lend the holder our level
+    while (!held) {
+        cond_wait(held_cond, lock);
+    }
+    print("Waiter has the lock\n");
+    kmutex_unlock(lock);
+
+    kmutex_close(lock);
+    cond_close(held_cond);
+    print_lock_stats();
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,36 @@
+.global ipc_send
+.global ipc_receive
+.global ipc_reply
+.global ipc_reply_receive
+
+@ Messages of 8 words travel in r1-r8, r4-r8 are saved around the call as the kernel hands them back changed
+@ System call numbers match SYS_IPC_SEND (0x37) to SYS_IPC_REPLY_RECEIVE (0x3A) in libc.h
+
+ipc_send:                       @ r0 = pid, r1 = message, r2 = reply buffer
+    push {r4-r9, lr}
+    mov r9, r2
+    ldm r1, {r1-r8}
+    svc #0x37
+    stm r9, {r1-r8}
+    pop {r4-r9, pc}
+
+ipc_receive:                    @ r0 = message buffer, returns the sender's pid
+    push {r4-r9, lr}
+    mov r9, r0
+    svc #0x38
+    stm r9, {r1-r8}
+    pop {r4-r9, pc}
+
+ipc_reply:                      @ r0 = pid, r1 = reply
+    push {r4-r8, lr}
+    ldm r1, {r1-r8}
+    svc #0x39
+    pop {r4-r8, pc}
+
+ipc_reply_receive:              @ r0 = pid, r1 = reply, r2 = message buffer, returns the next sender's pid
+    push {r4-r9, lr}
+    mov r9, r2
+    ldm r1, {r1-r8}
+    svc #0x3A
+    stm r9, {r1-r8}
+    pop {r4-r9, pc}
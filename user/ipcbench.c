@@ -0,0 +1,69 @@
+#include "libc.h"
+
+// Round trips per run
+#define TRIPS (1000)
+
+// Server request codes
+#define REQ_ADD  (1)
+#define REQ_QUIT (2)
+
+// Server, answers each request with the sum of its arguments until told to quit
+void ipc_server() {
+    ipc_msg_t msg;
+    ipc_msg_t reply;
+    int pid = ipc_receive(&msg);
+    while (msg.w[0] != REQ_QUIT) {
+        reply.w[0] = msg.w[1] + msg.w[2];
+        pid = ipc_reply_receive(pid, &reply, &msg);
+    }
+    ipc_reply(pid, &reply);
+    exit(EXIT_SUCCESS);
+}
+
+// Semaphore partner, posts back every post it is given
+void sem_server(int ping, int pong) {
+    for (int i = 0; i < TRIPS; i++) {
+        sem_wait(ping);
+        sem_post(pong);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+// Main function, times round trips through synchronous IPC and through a pair of semaphores
+void main_ipcbench() {
+    int server = fork();
+    if (server == 0) {
+        ipc_server();
+    }
+    ipc_msg_t msg = {{REQ_ADD, 0, 1}};
+    ipc_msg_t reply;
+    uint32_t begin = clock_ticks();
+    for (int i = 0; i < TRIPS; i++) {
+        msg.w[1] = i;
+        ipc_send(server, &msg, &reply);
+    }
+    uint32_t ipc_us = (clock_ticks() - begin) / CLOCK_TICKS_PER_US;
+    msg.w[0] = REQ_QUIT;
+    ipc_send(server, &msg, &reply);
+
+    int ping = sem_init(0);
+    int pong = sem_init(0);
+    if (fork() == 0) {
+        sem_server(ping, pong);
+    }
+    begin = clock_ticks();
+    for (int i = 0; i < TRIPS; i++) {
+        sem_post(ping);
+        sem_wait(pong);
+    }
+    uint32_t sem_us = (clock_ticks() - begin) / CLOCK_TICKS_PER_US;
+    sem_close(ping);
+    sem_close(pong);
+
+    print("IPC round trip (ns): ");
+    printI(ipc_us * 1000 / TRIPS);
+    print("\nSemaphore round trip (ns): ");
+    printI(sem_us * 1000 / TRIPS);
+    print("\n");
+    exit(EXIT_SUCCESS);
+}
@@ -151,55 +151,756 @@ void nice( int pid, int x ) {
   return;
 }
 
-uint32_t* sem_init(int val) {
-    uint32_t* sem;
+int shm_create(size_t size) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = size
+                  "svc %1     \n" // make system call SYS_SHM_CREATE
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SHM_CREATE), "r" (size)
+              : "r0" );
+    return r;
+}
+
+void* shm_attach(int id) {
+    void* r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = id
+                  "svc %1     \n" // make system call SYS_SHM_ATTACH
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SHM_ATTACH), "r" (id)
+              : "r0" );
+    return r;
+}
+
+int shm_detach(void* addr) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = addr
+                  "svc %1     \n" // make system call SYS_SHM_DETACH
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SHM_DETACH), "r" (addr)
+              : "r0" );
+    return r;
+}
+
+void* mmap(int fd, size_t len) {
+    void* r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = fd
+                  "mov r1, %3 \n" // assign r1 = len
+                  "svc %1     \n" // make system call SYS_MMAP
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MMAP), "r" (fd), "r" (len)
+              : "r0", "r1" );
+    return r;
+}
+
+int msync(void* addr) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = addr
+                  "svc %1     \n" // make system call SYS_MSYNC
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MSYNC), "r" (addr)
+              : "r0" );
+    return r;
+}
+
+int munmap(void* addr) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = addr
+                  "svc %1     \n" // make system call SYS_MUNMAP
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MUNMAP), "r" (addr)
+              : "r0" );
+    return r;
+}
+
+int mem_stats(int kind, void* buf, int max) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = kind
+                  "mov r1, %3 \n" // assign r1 = buf
+                  "mov r2, %4 \n" // assign r2 = max
+                  "svc %1     \n" // make system call SYS_MEM_STATS
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MEM_STATS), "r" (kind), "r" (buf), "r" (max)
+              : "r0", "r1", "r2" );
+    return r;
+}
+
+void print_mem_stats() {
+    kmem_site_t sites[64];
+    int n = mem_stats(MEM_SITES, sites, 64);
+    if (n < 0) {
+        print("Kernel heap callsite profiling is not built in\n");
+    } else {
+        print("Kernel heap by callsite (live bytes, peak bytes, allocations)\n");
+        for (int i = 0; i < n && i < 64; i++) {
+            print("\t");
+            print(sites[i].file);
+            print(":");
+            printI(sites[i].line);
+            print(" ");
+            printI(sites[i].live);
+            print(" ");
+            printI(sites[i].peak);
+            print(" ");
+            printI(sites[i].count);
+            print("\n");
+        }
+    }
+
+    kmem_cache_stat_t caches[32];
+    n = mem_stats(MEM_CACHES, caches, 32);
+    print("Kernel caches (object bytes, in use, peak, allocations, failures, wasted bytes)\n");
+    for (int i = 0; i < n && i < 32; i++) {
+        print("\t");
+        print(caches[i].name);
+        print(" ");
+        printI(caches[i].size);
+        print(" ");
+        printI(caches[i].inuse);
+        print(" ");
+        printI(caches[i].peak);
+        print(" ");
+        printI(caches[i].allocs);
+        print(" ");
+        printI(caches[i].failures);
+        print(" ");
+        printI(caches[i].wasted);
+        print("\n");
+    }
+
+    stack_mark_t stacks[MAX_PROCS + 3];
+    n = mem_stats(MEM_STACKS, stacks, MAX_PROCS + 3);
+    print("Stack high-water marks (used bytes / size)\n");
+    for (int i = 0; i < n && i < MAX_PROCS + 3; i++) {
+        print("\t");
+        if (stacks[i].pid >= 0) {
+            printI(stacks[i].pid);
+            print(" ");
+        }
+        print(stacks[i].name);
+        print(" ");
+        printI(stacks[i].used);
+        print(" / ");
+        printI(stacks[i].size);
+        print("\n");
+    }
+}
+
+void swap_stats(swap_stat_t* stats) {
+    asm volatile( "mov r0, %1 \n" // assign r0 = stats
+                  "svc %0     \n" // make system call SYS_SWAP_STATS
+              :
+              : "I" (SYS_SWAP_STATS), "r" (stats)
+              : "r0" );
+}
+
+void print_swap_stats() {
+    swap_stat_t stats;
+    swap_stats(&stats);
+
+    print("Resident pages: ");
+    printI(stats.resident);
+    print(", swapped pages: ");
+    printI(stats.swapped);
+    print(", free pages: ");
+    printI(stats.free_pages);
+    print("\nSwap ins: ");
+    printI(stats.swap_ins);
+    print(", swap outs: ");
+    printI(stats.swap_outs);
+    print("\nSwap in latency (us): average ");
+    printI(stats.swap_ins == 0 ? 0 : stats.fault_us_total / stats.swap_ins);
+    print(", max ");
+    printI(stats.fault_us_max);
+    print("\n");
+}
+
+int sem_init(int val) {
+    int r;
     asm volatile( "mov r0, %2 \n" // assign r0 = val
                   "svc %1     \n" // make system call SYS_SEM_INIT
-                  "mov %0, r0 \n"
-              : "=r" (sem)
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
               : "I" (SYS_SEM_INIT), "r" (val)
-              : );
-    return sem;
+              : "r0" );
+    return r;
+}
+
+int sem_close(int s) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = s
+                  "svc %1     \n" // make system call SYS_SEM_CLOSE
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SEM_CLOSE), "r" (s)
+              : "r0" );
+    return r;
+}
+
+int sem_post(int s) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = s
+                  "svc %1     \n" // make system call SYS_SEM_POST
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SEM_POST), "r" (s)
+              : "r0" );
+    return r;
+}
+
+int sem_wait(int s) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = s
+                  "svc %1     \n" // make system call SYS_SEM_WAIT
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SEM_WAIT), "r" (s)
+              : "r0" );
+    return r;
+}
+
+int futex(volatile uint32_t* addr, int op, uint32_t val) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = addr
+                  "mov r1, %3 \n" // assign r1 = op
+                  "mov r2, %4 \n" // assign r2 = val
+                  "svc %1     \n" // make system call SYS_FUTEX
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_FUTEX), "r" (addr), "r" (op), "r" (val)
+              : "r0", "r1", "r2" );
+    return r;
 }
 
-void sem_close(uint32_t* sem) {
-    asm volatile( "mov r0, %1 \n" // assign r0 = sem
-                  "svc %0     \n" // make system call SYS_SEM_CLOSE
+void mutex_init(mutex_t* m) {
+    *m = 0;
+}
+
+// Called by mutex_lock when the mutex is held, marks it contended and sleeps until it is handed back
+void mutex_lock_slow(mutex_t* m) {
+    while (atomic_swap(m, 2) != 0) {
+        futex(m, FUTEX_WAIT, 2);
+    }
+}
+
+// Called by mutex_unlock when there may be waiters, releases the mutex fully and wakes one of them
+void mutex_unlock_slow(mutex_t* m) {
+    *m = 0;
+    futex(m, FUTEX_WAKE, 1);
+}
+
+void semaphore_init(semaphore_t* s, int val) {
+    s->value = val;
+    s->waiters = 0;
+}
+
+void semaphore_wait(semaphore_t* s) {
+    if (semaphore_trywait(s)) {
+        return;
+    }
+    // Register as a waiter before sleeping, so a post that comes in between knows to wake us
+    atomic_add(&s->waiters, 1);
+    while (!semaphore_trywait(s)) {
+        futex((volatile uint32_t*) &s->value, FUTEX_WAIT, 0);
+    }
+    atomic_add(&s->waiters, -1);
+}
+
+// Called by semaphore_post when there are waiters, wakes one of them
+void semaphore_post_slow(semaphore_t* s) {
+    futex((volatile uint32_t*) &s->value, FUTEX_WAKE, 1);
+}
+
+void barrier_init(barrier_t* b, uint32_t parties) {
+    b->count = 0;
+    b->generation = 0;
+    b->parties = parties;
+    b->sleepers = 0;
+}
+
+int barrier_wait(barrier_t* b) {
+    // The generation cannot move on until we have arrived, so it is safe to read it first
+    uint32_t generation = b->generation;
+    if (barrier_arrive(b)) {
+        if (b->sleepers != 0) {
+            futex(&b->generation, FUTEX_WAKE, b->parties);
+        }
+        return 1;
+    }
+    // Register as a sleeper before checking, so the last process to arrive knows to wake us
+    atomic_add(&b->sleepers, 1);
+    while (b->generation == generation) {
+        futex(&b->generation, FUTEX_WAIT, generation);
+    }
+    atomic_add(&b->sleepers, -1);
+    return 0;
+}
+
+void rwlock_init(rwlock_t* rw) {
+    rw->state = 0;
+    rw->sleepers = 0;
+}
+
+// Called by rwlock_read_lock when a writer holds or is waiting for the lock, sleeps until there are none
+void rwlock_read_lock_slow(rwlock_t* rw) {
+    atomic_add(&rw->sleepers, 1);
+    while (1) {
+        uint32_t state = rw->state;
+        if ((state & ~RWLOCK_READERS) != 0) {
+            futex(&rw->state, FUTEX_WAIT, state);
+        } else if (atomic_cas(&rw->state, state, state + 1) == state) {
+            break;
+        }
+    }
+    atomic_add(&rw->sleepers, -1);
+}
+
+// Called by rwlock_write_lock when the lock is held, queues up as a waiting writer (holding back new readers) until it is free
+void rwlock_write_lock_slow(rwlock_t* rw) {
+    atomic_add(&rw->sleepers, 1);
+    atomic_add(&rw->state, RWLOCK_WRITER_WAIT);
+    while (1) {
+        uint32_t state = rw->state;
+        if ((state & (RWLOCK_READERS | RWLOCK_WRITER)) != 0) {
+            futex(&rw->state, FUTEX_WAIT, state);
+        } else if (atomic_cas(&rw->state, state, state - RWLOCK_WRITER_WAIT + RWLOCK_WRITER) == state) {
+            break;
+        }
+    }
+    atomic_add(&rw->sleepers, -1);
+}
+
+// Called by the unlocks when the lock may have become free and processes are sleeping, wakes all of them to retry
+void rwlock_wake(rwlock_t* rw) {
+    futex(&rw->state, FUTEX_WAKE, MAX_PROCS);
+}
+
+void spsc_init(spsc_ring_t* r) {
+    r->head = 0;
+    r->tail = 0;
+}
+
+int spsc_push(spsc_ring_t* r, uint32_t val) {
+    uint32_t tail = r->tail;
+    if (tail - r->head == RING_SIZE) {
+        return 0;
+    }
+    r->slots[tail % RING_SIZE] = val;
+    // The value must be in the slot before the consumer can see the new tail
+    memory_barrier();
+    r->tail = tail + 1;
+    return 1;
+}
+
+int spsc_pop(spsc_ring_t* r, uint32_t* val) {
+    uint32_t head = r->head;
+    if (head == r->tail) {
+        return 0;
+    }
+    memory_barrier();
+    *val = r->slots[head % RING_SIZE];
+    // The value must be read before the producer can see the slot is free
+    memory_barrier();
+    r->head = head + 1;
+    return 1;
+}
+
+void mpmc_init(mpmc_ring_t* r) {
+    r->head = 0;
+    r->tail = 0;
+    for (uint32_t i = 0; i < RING_SIZE; i++) {
+        r->cells[i].seq = i;
+    }
+    memory_barrier();
+}
+
+// A slot at position pos is free for a producer while its sequence is pos, and full for a consumer once it is pos + 1
+// -- A producer or consumer preempted between claiming a slot and updating its sequence only holds up that slot.
+int mpmc_push(mpmc_ring_t* r, uint32_t val) {
+    uint32_t pos = r->tail;
+    ring_cell_t* cell;
+    while (1) {
+        cell = &r->cells[pos % RING_SIZE];
+        int32_t diff = (int32_t) (cell->seq - pos);
+        if (diff < 0) {
+            return 0;
+        } else if (diff > 0) {
+            pos = r->tail;
+        } else {
+            uint32_t seen = atomic_cas(&r->tail, pos, pos + 1);
+            if (seen == pos) {
+                break;
+            }
+            pos = seen;
+        }
+    }
+    cell->value = val;
+    memory_barrier();
+    cell->seq = pos + 1;
+    return 1;
+}
+
+int mpmc_pop(mpmc_ring_t* r, uint32_t* val) {
+    uint32_t pos = r->head;
+    ring_cell_t* cell;
+    while (1) {
+        cell = &r->cells[pos % RING_SIZE];
+        int32_t diff = (int32_t) (cell->seq - (pos + 1));
+        if (diff < 0) {
+            return 0;
+        } else if (diff > 0) {
+            pos = r->head;
+        } else {
+            uint32_t seen = atomic_cas(&r->head, pos, pos + 1);
+            if (seen == pos) {
+                break;
+            }
+            pos = seen;
+        }
+    }
+    *val = cell->value;
+    memory_barrier();
+    cell->seq = pos + RING_SIZE;
+    return 1;
+}
+
+void lf_stack_init(lf_stack_t* s) {
+    s->head = 0;
+}
+
+void lf_stack_push(lf_stack_t* s, lf_node_t* node) {
+    uint64_t old;
+    do {
+        old = atomic_load64(&s->head);
+        node->next = (lf_node_t*) (uint32_t) old;
+    } while (!atomic_cas64(&s->head, old, (old & 0xFFFFFFFF00000000ULL) | (uint32_t) node));
+}
+
+lf_node_t* lf_stack_pop(lf_stack_t* s) {
+    uint64_t old;
+    lf_node_t* top;
+    do {
+        old = atomic_load64(&s->head);
+        top = (lf_node_t*) (uint32_t) old;
+        if (top == NULL) {
+            return NULL;
+        }
+        // top may already have been popped by someone else, in which case next is stale but the count will have moved on
+    } while (!atomic_cas64(&s->head, old, (old & 0xFFFFFFFF00000000ULL) + (1ULL << 32) + (uint32_t) top->next));
+    return top;
+}
+
+uint32_t clock_ticks() {
+    uint32_t r;
+    asm volatile( "svc %1     \n" // make system call SYS_CLOCK
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_CLOCK)
+              : "r0" );
+    return r;
+}
+
+int poll(pollfd_t* fds, uint32_t n, int timeout) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = fds
+                  "mov r1, %3 \n" // assign r1 = n
+                  "mov r2, %4 \n" // assign r2 = timeout
+                  "svc %1     \n" // make system call SYS_POLL
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_POLL), "r" (fds), "r" (n), "r" (timeout)
+              : "r0", "r1", "r2" );
+    return r;
+}
+
+int mq_open(const char* name, uint32_t capacity, uint32_t msg_size) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = name
+                  "mov r1, %3 \n" // assign r1 = capacity
+                  "mov r2, %4 \n" // assign r2 = msg_size
+                  "svc %1     \n" // make system call SYS_MQ_OPEN
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MQ_OPEN), "r" (name), "r" (capacity), "r" (msg_size)
+              : "r0", "r1", "r2" );
+    return r;
+}
+
+int mq_close(int mq) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = mq
+                  "svc %1     \n" // make system call SYS_MQ_CLOSE
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MQ_CLOSE), "r" (mq)
+              : "r0" );
+    return r;
+}
+
+int mq_unlink(const char* name) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = name
+                  "svc %1     \n" // make system call SYS_MQ_UNLINK
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MQ_UNLINK), "r" (name)
+              : "r0" );
+    return r;
+}
+
+int mq_timedsend(int mq, const void* msg, uint32_t len, uint32_t prio, int timeout) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = mq
+                  "mov r1, %3 \n" // assign r1 = msg
+                  "mov r2, %4 \n" // assign r2 = len
+                  "mov r3, %5 \n" // assign r3 = prio
+                  "mov r4, %6 \n" // assign r4 = timeout
+                  "svc %1     \n" // make system call SYS_MQ_SEND
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MQ_SEND), "r" (mq), "r" (msg), "r" (len), "r" (prio), "r" (timeout)
+              : "r0", "r1", "r2", "r3", "r4" );
+    return r;
+}
+
+int mq_send(int mq, const void* msg, uint32_t len, uint32_t prio) {
+    return mq_timedsend(mq, msg, len, prio, -1);
+}
+
+int mq_timedreceive(int mq, void* buf, uint32_t len, uint32_t* prio, int timeout) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = mq
+                  "mov r1, %3 \n" // assign r1 = buf
+                  "mov r2, %4 \n" // assign r2 = len
+                  "mov r3, %5 \n" // assign r3 = prio
+                  "mov r4, %6 \n" // assign r4 = timeout
+                  "svc %1     \n" // make system call SYS_MQ_RECEIVE
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MQ_RECEIVE), "r" (mq), "r" (buf), "r" (len), "r" (prio), "r" (timeout)
+              : "r0", "r1", "r2", "r3", "r4" );
+    return r;
+}
+
+int mq_receive(int mq, void* buf, uint32_t len, uint32_t* prio) {
+    return mq_timedreceive(mq, buf, len, prio, -1);
+}
+
+int kmutex_init() {
+    int r;
+    asm volatile( "svc %1     \n" // make system call SYS_KMUTEX_INIT
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_KMUTEX_INIT)
+              : "r0" );
+    return r;
+}
+
+int kmutex_close(int m) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = m
+                  "svc %1     \n" // make system call SYS_KMUTEX_CLOSE
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_KMUTEX_CLOSE), "r" (m)
+              : "r0" );
+    return r;
+}
+
+int kmutex_lock(int m) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = m
+                  "svc %1     \n" // make system call SYS_KMUTEX_LOCK
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_KMUTEX_LOCK), "r" (m)
+              : "r0" );
+    return r;
+}
+
+int kmutex_unlock(int m) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = m
+                  "svc %1     \n" // make system call SYS_KMUTEX_UNLOCK
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_KMUTEX_UNLOCK), "r" (m)
+              : "r0" );
+    return r;
+}
+
+int cond_init() {
+    int r;
+    asm volatile( "svc %1     \n" // make system call SYS_COND_INIT
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_COND_INIT)
+              : "r0" );
+    return r;
+}
+
+int cond_close(int c) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = c
+                  "svc %1     \n" // make system call SYS_COND_CLOSE
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_COND_CLOSE), "r" (c)
+              : "r0" );
+    return r;
+}
+
+int cond_wait(int c, int m) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = c
+                  "mov r1, %3 \n" // assign r1 = m
+                  "svc %1     \n" // make system call SYS_COND_WAIT
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_COND_WAIT), "r" (c), "r" (m)
+              : "r0", "r1" );
+    return r;
+}
+
+int cond_signal(int c) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = c
+                  "mov r1, %3 \n" // assign r1 = 0 (wake one)
+                  "svc %1     \n" // make system call SYS_COND_SIGNAL
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_COND_SIGNAL), "r" (c), "r" (0)
+              : "r0", "r1" );
+    return r;
+}
+
+int cond_broadcast(int c) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = c
+                  "mov r1, %3 \n" // assign r1 = 1 (wake all)
+                  "svc %1     \n" // make system call SYS_COND_SIGNAL
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_COND_SIGNAL), "r" (c), "r" (1)
+              : "r0", "r1" );
+    return r;
+}
+
+void lock_stats(lock_stat_t* stats) {
+    asm volatile( "mov r0, %1 \n" // assign r0 = stats
+                  "svc %0     \n" // make system call SYS_LOCK_STATS
               :
-              : "I" (SYS_SEM_CLOSE), "r" (sem)
-              : );
+              : "I" (SYS_LOCK_STATS), "r" (stats)
+              : "r0" );
+}
+
+void print_lock_stats() {
+    lock_stat_t stats;
+    lock_stats(&stats);
+
+    print("Mutex locks: ");
+    printI(stats.locks);
+    print(", contended: ");
+    printI(stats.contended);
+    print("\nPriority inversions: ");
+    printI(stats.inversions);
+    print(", boosts: ");
+    printI(stats.boosts);
+    print("\nInversion time (us): total ");
+    printI(stats.inversion_us_total);
+    print(", max ");
+    printI(stats.inversion_us_max);
+    print("\n");
 }
 
 void list_procs() {
-    char** names;
-    int* ids;
+    proc_info_t procs[MAX_PROCS];
     int len;
-    asm volatile( "svc %3 \n" // make system call SYS_LIST_PROC
-                  "mov %0, r0 \n" // names = r0
-                  "mov %1, r1 \n" // ids = r1
-                  "mov %2, r2 \n" // len = r2
-                : "=r" (names), "=r" (ids), "=r" (len)
-                : "I" (SYS_LIST_PROC)
-                : );
-
-    print("Active PIDS\n");
+    asm volatile( "mov r0, %2 \n" // assign r0 = procs
+                  "mov r1, %3 \n" // assign r1 = max
+                  "svc %1     \n" // make system call SYS_LIST_PROC
+                  "mov %0, r0 \n" // len = r0
+                : "=r" (len)
+                : "I" (SYS_LIST_PROC), "r" (procs), "r" (MAX_PROCS)
+                : "r0", "r1" );
+
+    print("Active PIDS (peak stack bytes)\n");
     for (int i = 0; i < len; i++) {
-        printI(ids[i]);
-        print("\n");
+        printI(procs[i].pid);
+        print(" (");
+        printI(procs[i].stack);
+        print(")\n");
     }
 }
 
-int open(const char* path) {
+int openat(int dirfd, const char* path, int mode) {
     int fd;
-    asm volatile( "mov r0, %2 \n" // assign r0 = path
+    asm volatile( "mov r0, %2 \n" // assign r0 = dirfd
+                  "mov r1, %3 \n" // assign r1 = path
+                  "mov r2, %4 \n" // assign r2 = mode
                   "svc %1     \n" // make system call SYS_OPEN
                   "mov %0, r0 \n" // fd = r0
               : "=r" (fd)
-              : "I" (SYS_OPEN), "r" (path)
-              : );
+              : "I" (SYS_OPEN), "r" (dirfd), "r" (path), "r" (mode)
+              : "r0", "r1", "r2" );
     return fd;
 }
 
+int open_mode(const char* path, int mode) {
+    return openat(AT_FDCWD, path, mode);
+}
+
+int open(const char* path) {
+    return open_mode(path, O_WRITE);
+}
+
+int lseek(int fd, int offset, int whence) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = fd
+                  "mov r1, %3 \n" // assign r1 = offset
+                  "mov r2, %4 \n" // assign r2 = whence
+                  "svc %1     \n" // make system call SYS_LSEEK
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_LSEEK), "r" (fd), "r" (offset), "r" (whence)
+              : "r0", "r1", "r2" );
+    return r;
+}
+
+int pread(int fd, void* x, size_t n, uint32_t offset) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = fd
+                  "mov r1, %3 \n" // assign r1 = x
+                  "mov r2, %4 \n" // assign r2 = n
+                  "mov r3, %5 \n" // assign r3 = offset
+                  "svc %1     \n" // make system call SYS_PREAD
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_PREAD), "r" (fd), "r" (x), "r" (n), "r" (offset)
+              : "r0", "r1", "r2", "r3" );
+    return r;
+}
+
+int pwrite(int fd, const void* x, size_t n, uint32_t offset) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = fd
+                  "mov r1, %3 \n" // assign r1 = x
+                  "mov r2, %4 \n" // assign r2 = n
+                  "mov r3, %5 \n" // assign r3 = offset
+                  "svc %1     \n" // make system call SYS_PWRITE
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_PWRITE), "r" (fd), "r" (x), "r" (n), "r" (offset)
+              : "r0", "r1", "r2", "r3" );
+    return r;
+}
+
 void close(int fd) {
     asm volatile( "mov r0, %1 \n" // assign r0 = fd
                   "svc %0     \n" // make system call SYS_CLOSE
@@ -208,54 +909,128 @@ void close(int fd) {
               : );
 }
 
-void remove(const char* path) {
-    asm volatile( "mov r0, %1 \n" // assign r0 = path
-                  "svc %0     \n" // make system call SYS_REMOVE
-              :
-              : "I" (SYS_REMOVE), "r" (path)
-              : );
+int pipe(int fds[2]) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = fds
+                  "svc %1     \n" // make system call SYS_PIPE
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_PIPE), "r" (fds)
+              : "r0", "memory" );
+    return r;
 }
 
-void mkdir(const char* path) {
-    asm volatile( "mov r0, %1 \n" // assign r0 = path
-                  "svc %0     \n" // make system call SYS_MKDIR
-              :
-              : "I" (SYS_MKDIR), "r" (path)
-              : );
+int dup2(int old_fd, int new_fd) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = old_fd
+                  "mov r1, %3 \n" // assign r1 = new_fd
+                  "svc %1     \n" // make system call SYS_DUP2
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_DUP2), "r" (old_fd), "r" (new_fd)
+              : "r0", "r1" );
+    return r;
 }
 
-void rmdir(const char* path) {
-    asm volatile( "mov r0, %1 \n" // assign r0 = path
-                  "svc %0     \n" // make system call SYS_RMDIR
-              :
-              : "I" (SYS_RMDIR), "r" (path)
-              : );
+// System calls behind the path functions, each looks its path up from a directory descriptor
+int removeat(int dirfd, const char* path) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = dirfd
+                  "mov r1, %3 \n" // assign r1 = path
+                  "svc %1     \n" // make system call SYS_REMOVE
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_REMOVE), "r" (dirfd), "r" (path)
+              : "r0", "r1" );
+    return r;
 }
 
-void chdir(const char* path) {
-    asm volatile( "mov r0, %1 \n" // assign r0 = path
-                  "svc %0     \n" // make system call SYS_CHDIR
-              :
-              : "I" (SYS_CHDIR), "r" (path)
-              : );
+int rmdirat(int dirfd, const char* path) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = dirfd
+                  "mov r1, %3 \n" // assign r1 = path
+                  "svc %1     \n" // make system call SYS_RMDIR
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_RMDIR), "r" (dirfd), "r" (path)
+              : "r0", "r1" );
+    return r;
 }
 
-char* getcwd() {
-    char* cwd;
-    asm volatile( "svc %1     \n" // make system call SYS_GETCWD
-                  "mov %0, r0 \n"
-              : "=r" (cwd)
-              : "I" (SYS_GETCWD)
-              : );
-    return cwd;
+int mkdirat(int dirfd, const char* path) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = dirfd
+                  "mov r1, %3 \n" // assign r1 = path
+                  "svc %1     \n" // make system call SYS_MKDIR
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_MKDIR), "r" (dirfd), "r" (path)
+              : "r0", "r1" );
+    return r;
+}
+
+int chdirat(int dirfd, const char* path) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = dirfd
+                  "mov r1, %3 \n" // assign r1 = path
+                  "svc %1     \n" // make system call SYS_CHDIR
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_CHDIR), "r" (dirfd), "r" (path)
+              : "r0", "r1" );
+    return r;
+}
+
+int listdirat(int dirfd, const char* path) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = dirfd
+                  "mov r1, %3 \n" // assign r1 = path
+                  "svc %1     \n" // make system call SYS_LISTDIR
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_LISTDIR), "r" (dirfd), "r" (path)
+              : "r0", "r1" );
+    return r;
+}
+
+int unlinkat(int dirfd, const char* path, int flags) {
+    return flags & AT_REMOVEDIR ? rmdirat(dirfd, path) : removeat(dirfd, path);
+}
+
+int remove(const char* path) {
+    return removeat(AT_FDCWD, path);
+}
+
+int mkdir(const char* path) {
+    return mkdirat(AT_FDCWD, path);
+}
+
+int rmdir(const char* path) {
+    return rmdirat(AT_FDCWD, path);
+}
+
+int chdir(const char* path) {
+    return chdirat(AT_FDCWD, path);
+}
+
+int fchdir(int fd) {
+    return chdirat(fd, "");
+}
+
+char* getcwd(char* buf, size_t size) {
+    int r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = buf
+                  "mov r1, %3 \n" // assign r1 = size
+                  "svc %1     \n" // make system call SYS_GETCWD
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_GETCWD), "r" (buf), "r" (size)
+              : "r0", "r1" );
+    return r == -1 ? NULL : buf;
 }
 
 void listdir(const char* path) {
-    asm volatile( "mov r0, %1 \n" // assign r0 = path
-                  "svc %0     \n" // make system call SYS_LISTDIR
-              :
-              : "I" (SYS_LISTDIR), "r" (path)
-              : );
+    listdirat(AT_FDCWD, path);
 }
 
 void* load(int fd) {
@@ -269,7 +1044,311 @@ void* load(int fd) {
     return ptr;
 }
 
-void print(char* str) {
+int sync() {
+    int r;
+    asm volatile( "svc %1     \n" // make system call SYS_SYNC
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SYNC)
+              : "r0" );
+    return r;
+}
+
+void bcache_stats(bcache_stat_t* stats) {
+    asm volatile( "mov r0, %1 \n" // assign r0 = stats
+                  "svc %0     \n" // make system call SYS_BCACHE_STATS
+              :
+              : "I" (SYS_BCACHE_STATS), "r" (stats)
+              : "r0" );
+}
+
+void print_bcache_stats() {
+    bcache_stat_t stats;
+    bcache_stats(&stats);
+
+    print("Block cache hits: ");
+    printI(stats.hits);
+    print(", misses: ");
+    printI(stats.misses);
+    print("\nWrite-backs: ");
+    printI(stats.writebacks);
+    print(", evictions: ");
+    printI(stats.evictions);
+    print("\nBlocks cached: ");
+    printI(stats.cached);
+    print(", dirty: ");
+    printI(stats.dirty);
+    print("\n");
+}
+
+void dcache_stats(dcache_stat_t* stats) {
+    asm volatile( "mov r0, %1 \n" // assign r0 = stats
+                  "svc %0     \n" // make system call SYS_DCACHE_STATS
+              :
+              : "I" (SYS_DCACHE_STATS), "r" (stats)
+              : "r0" );
+}
+
+void print_dcache_stats() {
+    dcache_stat_t stats;
+    dcache_stats(&stats);
+
+    print("Path cache hits: ");
+    printI(stats.hits);
+    print(" (");
+    printI(stats.negative);
+    print(" negative), misses: ");
+    printI(stats.misses);
+    print(", hit rate (%): ");
+    printI(stats.hits + stats.misses == 0 ? 0 : stats.hits * 100 / (stats.hits + stats.misses));
+    print("\nEvictions: ");
+    printI(stats.evictions);
+    print(", names cached: ");
+    printI(stats.cached);
+    print("\n");
+}
+
+void* sbrk(int incr) {
+    void* r;
+    asm volatile( "mov r0, %2 \n" // assign r0 = incr
+                  "svc %1     \n" // make system call SYS_SBRK
+                  "mov %0, r0 \n" // assign r  = r0
+              : "=r" (r)
+              : "I" (SYS_SBRK), "r" (incr)
+              : "r0" );
+    return r;
+}
+
+// Heap block, the payload starts at 'next'
+// -- Free large blocks store their size again in the following block's prev_size, so they can be merged.
+// -- Small blocks come in power of 2 sizes (16 to 2048 bytes, including the header) and are never merged.
+typedef struct block_t {
+    uint32_t prev_size;
+    uint32_t size;
+    struct block_t* next;
+    struct block_t* prev;
+} block_t;
+
+#define BLOCK_HEADER    ( 8 )
+#define BLOCK_MIN       ( 16 )
+#define BLOCK_USED      ( 0x1 )
+#define BLOCK_PREV_USED ( 0x2 )
+#define BLOCK_SMALL     ( 0x4 )
+#define BLOCK_FLAGS     ( 0x7 )
+#define SMALL_CLASSES   ( 8 )
+#define SMALL_RUN       ( 4096 )
+#define HEAP_CHUNK      ( 0x10000 )
+#define HEAP_TRIM       ( 0x40000 )
+#define ARENA_MAGIC     ( 0x48454150 )
+
+// Per-process heap state, kept in the first page of the process's window
+typedef struct {
+    uint32_t magic;
+    uint8_t* base;
+    block_t* top;
+    block_t* small[SMALL_CLASSES];
+    block_t* large;
+} arena_t;
+
+uint32_t block_size(block_t* b) {
+    return b->size & ~BLOCK_FLAGS;
+}
+
+block_t* next_block(block_t* b) {
+    return (block_t*) ((uint8_t*) b + block_size(b));
+}
+
+// Find the calling process's arena from its stack pointer, setting it up on first use
+arena_t* arena() {
+    uint32_t sp;
+    asm volatile( "mov %0, sp \n" : "=r" (sp) );
+    arena_t* a = (arena_t*) (sp & ~(PROC_WINDOW - 1));
+
+    if (a->magic != ARENA_MAGIC) {
+        a->base = sbrk(HEAP_CHUNK);
+        if (a->base == (void*) -1) {
+            return NULL;
+        }
+        a->top = (block_t*) a->base;
+        a->top->size = HEAP_CHUNK | BLOCK_PREV_USED;
+        for (int i = 0; i < SMALL_CLASSES; i++) {
+            a->small[i] = NULL;
+        }
+        a->large = NULL;
+        a->magic = ARENA_MAGIC;
+    }
+    return a;
+}
+
+void unlink_block(arena_t* a, block_t* b) {
+    if (b->prev != NULL) {
+        b->prev->next = b->next;
+    } else {
+        a->large = b->next;
+    }
+    if (b->next != NULL) {
+        b->next->prev = b->prev;
+    }
+}
+
+// Give a large block back, merging it with free neighbours (including the top of the heap)
+void release_block(arena_t* a, block_t* b) {
+    b->size &= ~BLOCK_USED;
+    if (!(b->size & BLOCK_PREV_USED)) {
+        block_t* prev = (block_t*) ((uint8_t*) b - b->prev_size);
+        unlink_block(a, prev);
+        prev->size += block_size(b);
+        b = prev;
+    }
+
+    block_t* next = next_block(b);
+    if (next == a->top) {
+        // Fold into the top, shrinking the heap if a lot of it is unused
+        b->size = (block_size(b) + block_size(next)) | (b->size & BLOCK_PREV_USED);
+        a->top = b;
+        if (block_size(b) > HEAP_TRIM) {
+            uint32_t excess = (block_size(b) - HEAP_CHUNK) & ~(HEAP_CHUNK - 1);
+            sbrk(-excess);
+            b->size -= excess;
+        }
+        return;
+    }
+    if (!(next->size & BLOCK_USED)) {
+        unlink_block(a, next);
+        b->size += block_size(next);
+    }
+
+    next = next_block(b);
+    next->prev_size = block_size(b);
+    next->size &= ~BLOCK_PREV_USED;
+    b->prev = NULL;
+    b->next = a->large;
+    if (a->large != NULL) {
+        a->large->prev = b;
+    }
+    a->large = b;
+}
+
+// Allocate a large block of an exact (8 byte aligned) size
+block_t* alloc_block(arena_t* a, uint32_t size) {
+    // First fit from the free blocks, splitting off any usable remainder
+    for (block_t* b = a->large; b != NULL; b = b->next) {
+        if (block_size(b) >= size) {
+            unlink_block(a, b);
+            uint32_t rem = block_size(b) - size;
+            b->size |= BLOCK_USED;
+            if (rem >= BLOCK_MIN) {
+                b->size = size | (b->size & BLOCK_FLAGS);
+                block_t* r = next_block(b);
+                r->size = rem | BLOCK_PREV_USED | BLOCK_USED;
+                release_block(a, r);
+            } else {
+                next_block(b)->size |= BLOCK_PREV_USED;
+            }
+            return b;
+        }
+    }
+
+    // Otherwise carve it from the top, growing the heap first if needed
+    if (block_size(a->top) < size + BLOCK_MIN) {
+        uint32_t grow = (size + BLOCK_MIN - block_size(a->top) + HEAP_CHUNK - 1) & ~(HEAP_CHUNK - 1);
+        if (sbrk(grow) == (void*) -1) {
+            return NULL;
+        }
+        a->top->size += grow;
+    }
+    block_t* b = a->top;
+    a->top = (block_t*) ((uint8_t*) b + size);
+    a->top->size = (block_size(b) - size) | BLOCK_PREV_USED;
+    b->size = size | BLOCK_USED | (b->size & BLOCK_PREV_USED);
+    return b;
+}
+
+void* malloc(size_t n) {
+    arena_t* a = arena();
+    if (n == 0 || a == NULL) {
+        return NULL;
+    }
+    uint32_t size = (n + BLOCK_HEADER + 7) & ~7;
+
+    // Small requests come from the free list of their size class, refilled a run at a time
+    for (int i = 0; i < SMALL_CLASSES; i++) {
+        uint32_t class = 16 << i;
+        if (size <= class) {
+            if (a->small[i] == NULL) {
+                uint32_t count = class < SMALL_RUN ? SMALL_RUN / class : 1;
+                block_t* run = alloc_block(a, class * count);
+                if (run == NULL) {
+                    return NULL;
+                }
+                for (int j = count - 1; j >= 0; j--) {
+                    block_t* b = (block_t*) ((uint8_t*) run + j * class);
+                    b->size = class | BLOCK_SMALL | BLOCK_USED | BLOCK_PREV_USED;
+                    b->next = a->small[i];
+                    a->small[i] = b;
+                }
+            }
+            block_t* b = a->small[i];
+            a->small[i] = b->next;
+            return &b->next;
+        }
+    }
+
+    // Large requests are split from free blocks or the top of the heap
+    block_t* b = alloc_block(a, size);
+    return b == NULL ? NULL : &b->next;
+}
+
+void* calloc(size_t n, size_t size) {
+    void* p = malloc(n * size);
+    if (p != NULL) {
+        memset(p, 0, n * size);
+    }
+    return p;
+}
+
+void* realloc(void* p, size_t n) {
+    if (p == NULL) {
+        return malloc(n);
+    }
+    // Keep the block if it is already big enough
+    block_t* b = (block_t*) ((uint8_t*) p - BLOCK_HEADER);
+    uint32_t old = block_size(b) - BLOCK_HEADER;
+    if (n <= old) {
+        return p;
+    }
+    void* q = malloc(n);
+    if (q != NULL) {
+        memcpy(q, p, old);
+        free(p);
+    }
+    return q;
+}
+
+void free(void* p) {
+    if (p == NULL) {
+        return;
+    }
+    arena_t* a = arena();
+    block_t* b = (block_t*) ((uint8_t*) p - BLOCK_HEADER);
+    if (b->size & BLOCK_SMALL) {
+        int i = __builtin_ctz(block_size(b)) - 4;
+        b->next = a->small[i];
+        a->small[i] = b;
+    } else {
+        release_block(a, b);
+    }
+}
+
+void arena_reset() {
+    arena_t* a = arena();
+    if (a != NULL) {
+        sbrk(a->base - (uint8_t*) sbrk(0));
+        a->magic = 0;
+    }
+}
+
+void print(const char* str) {
     write(STDOUT_FILENO, str, strlen(str));
 }
 
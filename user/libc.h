@@ -28,6 +28,46 @@
 #define SYS_GETCWD    ( 0x17 )
 #define SYS_LISTDIR   ( 0x18 )
 #define SYS_LOAD      ( 0x19 )
+#define SYS_SBRK      ( 0x1A )
+#define SYS_SHM_CREATE ( 0x1B )
+#define SYS_SHM_ATTACH ( 0x1C )
+#define SYS_SHM_DETACH ( 0x1D )
+#define SYS_MMAP      ( 0x1E )
+#define SYS_MUNMAP    ( 0x1F )
+#define SYS_MSYNC     ( 0x20 )
+#define SYS_SWAP_STATS ( 0x21 )
+#define SYS_MEM_STATS ( 0x22 )
+#define SYS_SEM_WAIT  ( 0x23 )
+#define SYS_SEM_POST  ( 0x24 )
+#define SYS_FUTEX     ( 0x25 )
+#define SYS_PIPE      ( 0x26 )
+#define SYS_DUP2      ( 0x27 )
+#define SYS_KMUTEX_INIT   ( 0x28 )
+#define SYS_KMUTEX_CLOSE  ( 0x29 )
+#define SYS_KMUTEX_LOCK   ( 0x2A )
+#define SYS_KMUTEX_UNLOCK ( 0x2B )
+#define SYS_COND_INIT     ( 0x2C )
+#define SYS_COND_CLOSE    ( 0x2D )
+#define SYS_COND_WAIT     ( 0x2E )
+#define SYS_COND_SIGNAL   ( 0x2F )
+#define SYS_LOCK_STATS    ( 0x30 )
+#define SYS_CLOCK         ( 0x31 )
+#define SYS_MQ_OPEN       ( 0x32 )
+#define SYS_MQ_CLOSE      ( 0x33 )
+#define SYS_MQ_UNLINK     ( 0x34 )
+#define SYS_MQ_SEND       ( 0x35 )
+#define SYS_MQ_RECEIVE    ( 0x36 )
+#define SYS_IPC_SEND      ( 0x37 )
+#define SYS_IPC_RECEIVE   ( 0x38 )
+#define SYS_IPC_REPLY     ( 0x39 )
+#define SYS_IPC_REPLY_RECEIVE ( 0x3A )
+#define SYS_POLL          ( 0x3B )
+#define SYS_SYNC          ( 0x3C )
+#define SYS_BCACHE_STATS  ( 0x3D )
+#define SYS_LSEEK         ( 0x3E )
+#define SYS_PREAD         ( 0x3F )
+#define SYS_PWRITE        ( 0x40 )
+#define SYS_DCACHE_STATS  ( 0x41 )
 
 // Kill process signals
 #define SIG_TERM      ( 0x00 )
@@ -37,11 +77,36 @@
 #define EXIT_SUCCESS  ( 0 )
 #define EXIT_FAILURE  ( 1 )
 
+// Process memory layout (must match the kernel's virtual memory windows)
+// -- The first page of a process's window holds its heap arena, so it can be found from the stack pointer.
+#define PROC_WINDOW   ( 0x1000000 )
+#define MAX_PROCS     ( 32 )
+
+// Kinds of statistics returned by SYS_MEM_STATS
+#define MEM_SITES     ( 0x0 )
+#define MEM_CACHES    ( 0x1 )
+#define MEM_STACKS    ( 0x2 )
+
 // Standard file descriptors
 #define  STDIN_FILENO ( 0 )
 #define STDOUT_FILENO ( 1 )
 #define STDERR_FILENO ( 2 )
 
+// Ways to open a file (O_WRITE allows reading as well), and where lseek measures from
+#define O_READ        ( 0x0 )
+#define O_WRITE       ( 0x1 )
+#define O_APPEND      ( 0x2 )
+#define SEEK_SET      ( 0x0 )
+#define SEEK_CUR      ( 0x1 )
+#define SEEK_END      ( 0x2 )
+
+// Directory descriptor meaning the current directory, and the unlinkat flag for removing a directory
+#define AT_FDCWD      ( -100 )
+#define AT_REMOVEDIR  ( 0x200 )
+
+// Largest pipe write that is guaranteed not to be interleaved
+#define PIPE_ATOMIC   ( 128 )
+
 // Convert ASCII string x into integer r
 int atoi(char* x);
 // Convert integer x into ASCII string r
@@ -55,23 +120,81 @@ int write(int fd, const void* x, size_t n);
 // Read n bytes into x from the file descriptor fd; return bytes read
 int read(int fd, void* x, size_t n);
 // Open a file at a given path, if it doesn't exist then create a new file.
+// -- Reads and writes start at the beginning of the file and move on through it.
 int open(const char* pathname);
+// Open a file as open does, with the given O_ mode; with O_APPEND every write goes on the end of the file
+int open_mode(const char* pathname, int mode);
+// Move a file's offset to offset from SEEK_SET, SEEK_CUR or SEEK_END; return the new offset (or -1)
+int lseek(int fd, int offset, int whence);
+// Read or write n bytes at a given offset without moving the file's offset; return bytes done (or -1)
+int pread(int fd, void* x, size_t n, uint32_t offset);
+int pwrite(int fd, const void* x, size_t n, uint32_t offset);
 // Close a file
 void close(int fd);
-// Delete a file
-void remove(const char* pathname);
-// Make a directory
-void mkdir(const char* pathname);
-// Remove an empty directory
-void rmdir(const char* pathname);
-// Change current directory
-void chdir(const char* pathname);
-// Print current directory
-char* getcwd();
+// Create a pipe, fds[0] is the read end and fds[1] the write end; return 0 (or -1)
+// -- Reads block while the pipe is empty (and return 0 once every write end is closed), writes block while it is full.
+// -- Writes of up to PIPE_ATOMIC bytes are never interleaved with other writes.
+int pipe(int fds[2]);
+// Make new_fd refer to the same file as old_fd (closing new_fd first); return new_fd (or -1)
+int dup2(int old_fd, int new_fd);
+// Delete a file; return 0 (or -1)
+int remove(const char* pathname);
+// Make a directory; return 0 (or -1)
+int mkdir(const char* pathname);
+// Remove an empty directory; return 0 (or -1)
+int rmdir(const char* pathname);
+// Change current directory; return 0 (or -1)
+int chdir(const char* pathname);
+// Write the current directory's path into buf (size bytes); return buf (or NULL if it does not fit)
+char* getcwd(char* buf, size_t size);
 // List the conctents of the dir
 void listdir(const char* pathname);
+
+// Versions of the path calls that look a relative path up from the directory open as dirfd (AT_FDCWD for the current directory)
+// -- A directory is opened with openat or open_mode and O_READ, an absolute path ignores dirfd.
+int openat(int dirfd, const char* pathname, int mode);
+int mkdirat(int dirfd, const char* pathname);
+int removeat(int dirfd, const char* pathname);
+int rmdirat(int dirfd, const char* pathname);
+int chdirat(int dirfd, const char* pathname);
+int listdirat(int dirfd, const char* pathname);
+// Remove a file, or an empty directory if flags has AT_REMOVEDIR; return 0 (or -1)
+int unlinkat(int dirfd, const char* pathname, int flags);
+// Make the directory open as fd the current directory; return 0 (or -1)
+int fchdir(int fd);
 // Load program into memory
 void* load(int fd);
+// Write every modified filesystem block held in the kernel's buffer cache back to the disk, returns how many were written (or -1)
+int sync();
+
+// Buffer cache counters, dirty and cached are the blocks held right now
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t writebacks;
+    uint32_t evictions;
+    uint32_t dirty;
+    uint32_t cached;
+} bcache_stat_t;
+
+// Get the kernel's buffer cache counters
+void bcache_stats(bcache_stat_t* stats);
+// Print the buffer cache counters
+void print_bcache_stats();
+
+// Path lookup cache counters, negative counts the hits that found a name missing and cached is the entries held right now
+typedef struct {
+    uint32_t hits;
+    uint32_t negative;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t cached;
+} dcache_stat_t;
+
+// Get the kernel's path lookup cache counters
+void dcache_stats(dcache_stat_t* stats);
+// Print the path lookup cache counters
+void print_dcache_stats();
 
 // Clone process, returning 0 iff. child or > 0 iff. parent process
 int fork();
@@ -87,18 +210,324 @@ void nice(int pid, int x);
 // List all currently running processes 
 void list_procs();
 
-// Initialise a semaphore with a given value
-uint32_t* sem_init(int val);
-// Deallocate a semaphore
-void sem_close(uint32_t* s);
+// Move the end of the heap by incr bytes, returning the old end (or (void*) -1 on failure)
+void* sbrk(int incr);
+// Allocate n bytes from the heap
+void* malloc(size_t n);
+// Allocate an array of n zeroed elements of a given size
+void* calloc(size_t n, size_t size);
+// Resize an allocation to n bytes, moving it if needed
+void* realloc(void* p, size_t n);
+// Give an allocation back to the heap
+void free(void* p);
+// Free every allocation at once and give the heap's memory back to the kernel
+void arena_reset();
+
+// Create a zeroed shared memory segment of up to 1 MiB, returning its id (or -1)
+int shm_create(size_t size);
+// Map a shared memory segment into this process, returning its address (or NULL)
+// -- Attachments are not inherited by fork, a child attaches for itself.
+void* shm_attach(int id);
+// Unmap a shared memory segment, it is freed once no process has it attached
+int shm_detach(void* addr);
+
+// Map the first len bytes (up to 1 MiB) of an open file into this process, returning its address (or NULL)
+// -- Pages are read from the disk when first touched, and only written back by msync or munmap.
+void* mmap(int fd, size_t len);
+// Write back the modified pages of a mapped file
+int msync(void* addr);
+// Write back and unmap a mapped file
+int munmap(void* addr);
+
+// Swap counters, fault times cover swapping a page back in (and anything written out to make room)
+typedef struct {
+    uint32_t swap_ins;
+    uint32_t swap_outs;
+    uint32_t resident;
+    uint32_t swapped;
+    uint32_t free_pages;
+    uint32_t fault_us_total;
+    uint32_t fault_us_max;
+} swap_stat_t;
+
+// Process information filled in by SYS_LIST_PROC
+typedef struct {
+    int pid;
+    const char* name;
+    uint32_t stack;
+} proc_info_t;
+
+// Kernel heap usage of one allocation site (file and line), in bytes
+typedef struct {
+    const char* file;
+    uint32_t line;
+    uint32_t live;
+    uint32_t peak;
+    uint32_t count;
+} kmem_site_t;
+
+// Usage of one kernel object cache
+typedef struct {
+    const char* name;
+    uint32_t size;
+    uint32_t inuse;
+    uint32_t peak;
+    uint32_t allocs;
+    uint32_t failures;
+    uint32_t wasted;
+} kmem_cache_stat_t;
+
+// Deepest use of a kernel mode stack (pid -1) or a process stack, in bytes
+typedef struct {
+    const char* name;
+    int pid;
+    uint32_t size;
+    uint32_t used;
+} stack_mark_t;
+
+// Copy up to max records of a kind of memory statistic into buf, returns how many there are (or -1)
+int mem_stats(int kind, void* buf, int max);
+// Print the kernel heap callsites, object caches and stack high-water marks
+void print_mem_stats();
+
+// Get the kernel's swap counters
+void swap_stats(swap_stat_t* stats);
+// Print the swap counters
+void print_swap_stats();
+
+// Initialise a semaphore with a given value, returns its id (or -1)
+// -- Semaphores live in the kernel, so ids can be shared with forked children.
+int sem_init(int val);
+// Deallocate a semaphore, fails (-1) while processes are waiting on it
+int sem_close(int s);
+
+// Increment a semaphore s, waking the longest waiting process if there is one
+int sem_post(int s);
+// Decrement a semaphore s, blocking until it can be done
+int sem_wait(int s);
+
+// Futex operations
+#define FUTEX_WAIT    ( 0 )
+#define FUTEX_WAKE    ( 1 )
+
+// Sleep while *addr == val (FUTEX_WAIT), or wake up to val processes sleeping on addr (FUTEX_WAKE)
+// -- WAIT returns -1 straight away if *addr no longer holds val, WAKE returns how many processes were woken.
+int futex(volatile uint32_t* addr, int op, uint32_t val);
+
+// Mutex, 0 when unlocked, 1 when locked and 2 when locked with processes (possibly) waiting
+// -- Locking and unlocking only enter the kernel when the mutex is contended.
+typedef volatile uint32_t mutex_t;
+
+// Counting semaphore, posting only enters the kernel when there are waiters and waiting only when the count is 0
+typedef struct {
+    volatile int32_t value;
+    volatile uint32_t waiters;
+} semaphore_t;
+
+// Barrier for a fixed number of parties, waiting only enters the kernel for processes that have to sleep
+typedef struct {
+    volatile uint32_t count;
+    volatile uint32_t generation;
+    uint32_t parties;
+    volatile uint32_t sleepers;
+} barrier_t;
+
+// Writer-preferring reader-writer lock, readers hold back while any writer holds or waits for the lock
+// -- The state counts readers in bits 0-15, RWLOCK_WRITER is set while a writer holds it and waiting writers add RWLOCK_WRITER_WAIT.
+typedef struct {
+    volatile uint32_t state;
+    volatile uint32_t sleepers;
+} rwlock_t;
+
+#define RWLOCK_READERS     ( 0xFFFF )
+#define RWLOCK_WRITER      ( 0x10000 )
+#define RWLOCK_WRITER_WAIT ( 0x20000 )
+
+// Slots in a lock-free ring queue, a power of two so positions can run on past the end and wrap
+#define RING_SIZE          ( 64 )
+
+// Single producer, single consumer ring queue, each side only ever writes its own position
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t slots[RING_SIZE];
+} spsc_ring_t;
+
+// Multi-producer, multi-consumer ring queue, each slot carries a sequence number saying whose turn it is
+// -- A slot is only reused once its sequence has gone a whole lap further on, so a stale position can never claim it (no ABA).
+typedef struct {
+    volatile uint32_t seq;
+    volatile uint32_t value;
+} ring_cell_t;
+
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    ring_cell_t cells[RING_SIZE];
+} mpmc_ring_t;
+
+// Node of a lock-free stack, embedded in whatever is pushed
+typedef struct lf_node_t {
+    struct lf_node_t* volatile next;
+} lf_node_t;
+
+// Treiber stack, the top node is in the low word of head and a count of pops in the high word
+// -- Every pop changes the count, so a node that is popped and pushed back in between cannot fool another pop (no ABA).
+typedef struct {
+    volatile uint64_t head;
+} lf_stack_t;
+
+// Atomically replace *addr with val, returns the old value
+uint32_t atomic_swap(volatile uint32_t* addr, uint32_t val);
+// Atomically add delta to *addr, returns the new value
+uint32_t atomic_add(volatile uint32_t* addr, int delta);
+// Atomically replace *addr with val if it holds old, returns the value it held
+uint32_t atomic_cas(volatile uint32_t* addr, uint32_t old, uint32_t val);
+// Atomically add delta to *addr, returns the old value
+uint32_t atomic_fetch_add(volatile uint32_t* addr, int delta);
+// Atomically replace a doubleword with val if it holds old, returns 1 if it did (addr must be 8 byte aligned)
+int atomic_cas64(volatile uint64_t* addr, uint64_t old, uint64_t val);
+// Read a doubleword in one go
+uint64_t atomic_load64(volatile uint64_t* addr);
+// Stop memory accesses moving across this point, in either direction
+void memory_barrier();
+// Count a party in at a barrier, returns 1 for the last one to arrive (which has opened the barrier)
+int barrier_arrive(barrier_t* b);
+
+// Initialise, lock and unlock a mutex (which must be in memory shared by every process using it)
+void mutex_init(mutex_t* m);
+void mutex_lock(mutex_t* m);
+void mutex_unlock(mutex_t* m);
+
+// Initialise, wait on and post to a semaphore (which must be in memory shared by every process using it)
+void semaphore_init(semaphore_t* s, int val);
+void semaphore_wait(semaphore_t* s);
+int semaphore_trywait(semaphore_t* s);
+void semaphore_post(semaphore_t* s);
+
+// Initialise a barrier for a number of parties, and wait until they have all arrived
+// -- Returns 1 to exactly one of the parties each time the barrier opens.
+void barrier_init(barrier_t* b, uint32_t parties);
+int barrier_wait(barrier_t* b);
+
+// Initialise, lock and unlock a reader-writer lock (which must be in memory shared by every process using it)
+void rwlock_init(rwlock_t* rw);
+void rwlock_read_lock(rwlock_t* rw);
+void rwlock_read_unlock(rwlock_t* rw);
+void rwlock_write_lock(rwlock_t* rw);
+void rwlock_write_unlock(rwlock_t* rw);
+
+// Initialise a ring queue, then add or take a value without ever waiting
+// -- Push returns 0 when the queue is full and pop returns 0 when it is empty, leaving the caller to retry or yield.
+void spsc_init(spsc_ring_t* r);
+int spsc_push(spsc_ring_t* r, uint32_t val);
+int spsc_pop(spsc_ring_t* r, uint32_t* val);
+void mpmc_init(mpmc_ring_t* r);
+int mpmc_push(mpmc_ring_t* r, uint32_t val);
+int mpmc_pop(mpmc_ring_t* r, uint32_t* val);
+
+// Initialise a stack, push a node onto it and pop the top node (or NULL if it is empty)
+// -- The stack must be 8 byte aligned, and nodes must stay readable while the stack is in use (they are never freed by it).
+void lf_stack_init(lf_stack_t* s);
+void lf_stack_push(lf_stack_t* s, lf_node_t* node);
+lf_node_t* lf_stack_pop(lf_stack_t* s);
+
+// Ticks of the 24MHz system counter, differences are correct across a wrap
+#define CLOCK_TICKS_PER_US ( 24 )
+uint32_t clock_ticks();
+
+// Kernel mutex counters, inversion time is how long mutexes were held below the level of one of their waiters
+typedef struct {
+    uint32_t locks;
+    uint32_t contended;
+    uint32_t inversions;
+    uint32_t boosts;
+    uint32_t inversion_us_total;
+    uint32_t inversion_us_max;
+} lock_stat_t;
+
+// Create a kernel mutex, returns its id (or -1)
+// -- The holder inherits the scheduling level of its most urgent waiter, so it cannot be starved while holding it.
+int kmutex_init();
+// Deallocate a kernel mutex, fails (-1) while it is held
+int kmutex_close(int m);
+// Lock and unlock a kernel mutex, unlocking hands it straight to the most urgent waiter
+int kmutex_lock(int m);
+int kmutex_unlock(int m);
+
+// Create a condition variable, returns its id (or -1)
+int cond_init();
+// Deallocate a condition variable, fails (-1) while processes are waiting on it
+int cond_close(int c);
+// Release kernel mutex m and sleep until signalled, m is held again when this returns
+int cond_wait(int c, int m);
+// Wake the longest waiter, or every waiter, returns how many were woken
+int cond_signal(int c);
+int cond_broadcast(int c);
+
+// Get the kernel's lock counters
+void lock_stats(lock_stat_t* stats);
+// Print the lock counters
+void print_lock_stats();
+
+// Limits of message queues, and the results of a send or receive other than success
+#define MQ_MAX_MSGS   ( 64 )
+#define MQ_MSG_SIZE   ( 256 )
+#define MQ_ERROR      ( -1 )
+#define MQ_TIMEDOUT   ( -2 )
+#define MQ_AGAIN      ( -3 )
+
+// Open the named message queue, creating it (if capacity is not 0) with room for capacity messages of up to msg_size bytes
+// -- Returns the queue's id (or -1), which can be passed on to forked children (only the process that opened it closes it).
+int mq_open(const char* name, uint32_t capacity, uint32_t msg_size);
+// Close a queue, and remove its name so it can no longer be opened (it goes once everyone has closed it)
+int mq_close(int mq);
+int mq_unlink(const char* name);
+
+// Send a message of len bytes with a priority, higher priority messages are received first
+// -- mq_send blocks while the queue is full, mq_timedsend waits for at most timeout ms (0 never waits).
+int mq_send(int mq, const void* msg, uint32_t len, uint32_t prio);
+int mq_timedsend(int mq, const void* msg, uint32_t len, uint32_t prio, int timeout);
+// Receive the highest priority message into a buffer of len bytes (at least the queue's message size), returns its length
+// -- The priority is stored in prio unless it is NULL, and the waiting works as for sending.
+int mq_receive(int mq, void* buf, uint32_t len, uint32_t* prio);
+int mq_timedreceive(int mq, void* buf, uint32_t len, uint32_t* prio, int timeout);
+
+// Synchronous message, passed entirely in registers
+#define IPC_WORDS     ( 8 )
+typedef struct {
+    uint32_t w[IPC_WORDS];
+} ipc_msg_t;
+
+// Send a message to process pid and wait for its reply, returns 0 (or -1 if pid does not exist or exits before replying)
+int ipc_send(int pid, const ipc_msg_t* msg, ipc_msg_t* reply);
+// Wait for the next message, returns the pid of its sender (who waits until it is replied to)
+int ipc_receive(ipc_msg_t* msg);
+// Reply to a sender, returns 0 (or -1 if pid is not waiting on a reply from us)
+int ipc_reply(int pid, const ipc_msg_t* reply);
+// Reply to a sender and wait for the next message in one call, returns the pid of the next sender
+// -- If nobody else is waiting the CPU goes straight back to the sender, so a round trip is two context switches.
+int ipc_reply_receive(int pid, const ipc_msg_t* reply, ipc_msg_t* msg);
+
+// Poll events
+#define POLLIN        ( 0x01 )
+#define POLLOUT       ( 0x04 )
+#define POLLHUP       ( 0x10 )
+#define POLLNVAL      ( 0x20 )
+
+// Descriptor to watch, and the events that are ready on it
+typedef struct {
+    int fd;
+    short events;
+    short revents;
+} pollfd_t;
 
-// Increment a semaphore s
-void sem_post(uint32_t* s);
-// Decrement a semaphore s
-void sem_wait(uint32_t* s);
+// Wait until one of n descriptors is ready, for at most timeout ms (0 never waits, -1 waits for as long as it takes)
+// -- Returns how many descriptors have events in revents, 0 on a timeout. With no descriptors it just sleeps.
+int poll(pollfd_t* fds, uint32_t n, int timeout);
 
 // Print functions for strings and integers
-void print(char* s);
+void print(const char* s);
 void printI(int i);
 
 // Random number generation
@@ -0,0 +1,193 @@
+#include "libc.h"
+
+// Values passed through each queue, and the number of processes on each side
+#define ITEMS (20000)
+#define PRODUCERS (2)
+#define CONSUMERS (2)
+
+// Nodes shared through the stack, the processes passing them around and how many times each one does so
+#define STACK_NODES (32)
+#define STACK_WORKERS (4)
+#define STACK_ROUNDS (5000)
+
+// Node that remembers who has it popped, so a node handed to two processes at once is noticed
+typedef struct {
+    lf_node_t node;
+    volatile uint32_t owner;
+} stress_node_t;
+
+// Queues, stack and results, globals are shared by every process
+spsc_ring_t stress_spsc;
+mpmc_ring_t stress_mpmc;
+lf_stack_t stress_stack;
+stress_node_t stress_nodes[STACK_NODES];
+barrier_t stress_start;
+barrier_t stress_done;
+volatile uint32_t stress_sum;
+volatile uint32_t stress_count;
+volatile uint32_t stress_errors;
+
+// Print a run's throughput and how many errors it found
+void stress_report(const char* name, uint32_t ops, uint32_t us) {
+    print(name);
+    print(": ops per second ");
+    printI(us == 0 ? 0 : (uint32_t) ((uint64_t) ops * 1000000 / us));
+    print(", errors ");
+    printI(stress_errors);
+    print("\n");
+}
+
+// Pass 1 to ITEMS from a child to the parent, which checks they arrive in order
+uint32_t stress_spsc_run() {
+    spsc_init(&stress_spsc);
+    barrier_init(&stress_start, 2);
+    if (fork() == 0) {
+        barrier_wait(&stress_start);
+        for (uint32_t i = 1; i <= ITEMS; i++) {
+            while (!spsc_push(&stress_spsc, i)) {
+                yield();
+            }
+        }
+        exit(EXIT_SUCCESS);
+    }
+    barrier_wait(&stress_start);
+    uint32_t begin = clock_ticks();
+    for (uint32_t i = 1; i <= ITEMS; i++) {
+        uint32_t val;
+        while (!spsc_pop(&stress_spsc, &val)) {
+            yield();
+        }
+        if (val != i) {
+            stress_errors++;
+        }
+    }
+    return (clock_ticks() - begin) / CLOCK_TICKS_PER_US;
+}
+
+// Producer for the MPMC run, tags each value with its id in the top byte
+void mpmc_producer(uint32_t id) {
+    barrier_wait(&stress_start);
+    for (uint32_t i = 1; i <= ITEMS / PRODUCERS; i++) {
+        while (!mpmc_push(&stress_mpmc, id << 24 | i)) {
+            yield();
+        }
+    }
+    exit(EXIT_SUCCESS);
+}
+
+// Consumer for the MPMC run, values from any one producer must come out in the order they went in
+void mpmc_consumer() {
+    uint32_t last[PRODUCERS] = {0};
+    barrier_wait(&stress_start);
+    while (stress_count < ITEMS) {
+        uint32_t val;
+        if (!mpmc_pop(&stress_mpmc, &val)) {
+            yield();
+            continue;
+        }
+        uint32_t id = val >> 24;
+        uint32_t i = val & 0xFFFFFF;
+        if (id >= PRODUCERS || i <= last[id]) {
+            atomic_add(&stress_errors, 1);
+        } else {
+            last[id] = i;
+        }
+        atomic_add(&stress_sum, i);
+        atomic_add(&stress_count, 1);
+    }
+    barrier_wait(&stress_done);
+    exit(EXIT_SUCCESS);
+}
+
+// Pass ITEMS values from several producers to several consumers, then check every one arrived exactly once
+uint32_t stress_mpmc_run() {
+    mpmc_init(&stress_mpmc);
+    barrier_init(&stress_start, PRODUCERS + CONSUMERS + 1);
+    barrier_init(&stress_done, CONSUMERS + 1);
+    stress_sum = 0;
+    stress_count = 0;
+    for (uint32_t id = 0; id < PRODUCERS; id++) {
+        if (fork() == 0) {
+            mpmc_producer(id);
+        }
+    }
+    for (int i = 0; i < CONSUMERS; i++) {
+        if (fork() == 0) {
+            mpmc_consumer();
+        }
+    }
+    barrier_wait(&stress_start);
+    uint32_t begin = clock_ticks();
+    barrier_wait(&stress_done);
+    uint32_t us = (clock_ticks() - begin) / CLOCK_TICKS_PER_US;
+
+    uint32_t n = ITEMS / PRODUCERS;
+    if (stress_count != ITEMS || stress_sum != PRODUCERS * (n * (n + 1) / 2)) {
+        stress_errors++;
+    }
+    return us;
+}
+
+// Worker for the stack run, pops a node, marks it as its own, then pushes it back
+void stack_worker(uint32_t id) {
+    barrier_wait(&stress_start);
+    for (int r = 0; r < STACK_ROUNDS; r++) {
+        stress_node_t* n = (stress_node_t*) lf_stack_pop(&stress_stack);
+        if (n == NULL) {
+            yield();
+            continue;
+        }
+        if (atomic_swap(&n->owner, id) != 0) {
+            atomic_add(&stress_errors, 1);
+        }
+        n->owner = 0;
+        lf_stack_push(&stress_stack, &n->node);
+    }
+    barrier_wait(&stress_done);
+    exit(EXIT_SUCCESS);
+}
+
+// Pass nodes around through the stack, then check each one is back on it exactly once
+uint32_t stress_stack_run() {
+    lf_stack_init(&stress_stack);
+    for (int i = 0; i < STACK_NODES; i++) {
+        stress_nodes[i].owner = 0;
+        lf_stack_push(&stress_stack, &stress_nodes[i].node);
+    }
+    barrier_init(&stress_start, STACK_WORKERS + 1);
+    barrier_init(&stress_done, STACK_WORKERS + 1);
+    for (uint32_t id = 1; id <= STACK_WORKERS; id++) {
+        if (fork() == 0) {
+            stack_worker(id);
+        }
+    }
+    barrier_wait(&stress_start);
+    uint32_t begin = clock_ticks();
+    barrier_wait(&stress_done);
+    uint32_t us = (clock_ticks() - begin) / CLOCK_TICKS_PER_US;
+
+    int count = 0;
+    stress_node_t* n;
+    while ((n = (stress_node_t*) lf_stack_pop(&stress_stack)) != NULL) {
+        if (n->owner != 0) {
+            stress_errors++;
+        }
+        n->owner = 1;
+        count++;
+    }
+    if (count != STACK_NODES) {
+        stress_errors++;
+    }
+    return us;
+}
+
+// Main function, stress tests each lock-free structure with processes that are preempted at arbitrary points
+void main_lockfree() {
+    stress_errors = 0;
+    stress_report("SPSC ring", ITEMS * 2, stress_spsc_run());
+    stress_errors = 0;
+    stress_report("MPMC ring", ITEMS * 2, stress_mpmc_run());
+    stress_errors = 0;
+    stress_report("Treiber stack", STACK_WORKERS * STACK_ROUNDS * 2, stress_stack_run());
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,52 @@
+#include "libc.h"
+
+// Number of producers, how many jobs each sends, and how long the consumer waits before deciding they are done
+#define PRODUCERS (3)
+#define JOBS (4)
+#define IDLE_MS (500)
+
+// Job passed through the queue, producer i sends at priority i
+typedef struct {
+    int producer;
+    int seq;
+} job_t;
+
+// Send JOBS jobs, blocking whenever the queue is full
+void job_producer(int mq, int id) {
+    for (int seq = 0; seq < JOBS; seq++) {
+        job_t job = {id, seq};
+        mq_send(mq, &job, sizeof(job), id);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+// Main function, takes jobs (most urgent first) from the forked producers until the queue has been idle for a while
+void main_mq() {
+    int mq = mq_open("jobs", 4, sizeof(job_t));
+    if (mq == -1) {
+        print("Could not create message queue\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < PRODUCERS; i++) {
+        if (fork() == 0) {
+            job_producer(mq, i);
+        }
+    }
+
+    job_t job;
+    uint32_t prio;
+    while (mq_timedreceive(mq, &job, sizeof(job), &prio, IDLE_MS) != MQ_TIMEDOUT) {
+        print("Job ");
+        printI(job.seq);
+        print(" from producer ");
+        printI(job.producer);
+        print(" at priority ");
+        printI(prio);
+        print("\n");
+    }
+    print("No jobs for 500 ms, done\n");
+
+    mq_close(mq);
+    mq_unlink("jobs");
+    exit(EXIT_SUCCESS);
+}
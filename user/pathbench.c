@@ -0,0 +1,47 @@
+#include "libc.h"
+
+// Depth of the directory tree, and how many times the file at the bottom is opened
+#define DEPTH (5)
+#define OPENS (200)
+
+// Directories from the top of the tree down, and the file at the bottom
+const char* bench_dirs[DEPTH] = {"pb", "pb/d1", "pb/d1/d2", "pb/d1/d2/d3", "pb/d1/d2/d3/d4"};
+const char* bench_file = "pb/d1/d2/d3/d4/leaf";
+
+// Open and close a path, the kernel splits the path up in place so it is given a fresh copy each time
+void bench_open(const char* path) {
+    char buf[64];
+    strcpy(buf, path);
+    close(open(buf));
+}
+
+// Main function, times repeated opens of a file five directories down, reporting the path cache counters
+void main_pathbench() {
+    char buf[64];
+    for (int i = 0; i < DEPTH; i++) {
+        strcpy(buf, bench_dirs[i]);
+        mkdir(buf);
+    }
+    bench_open(bench_file);
+
+    uint32_t t0 = clock_ticks();
+    for (int i = 0; i < OPENS; i++) {
+        bench_open(bench_file);
+    }
+    uint32_t us = (clock_ticks() - t0) / CLOCK_TICKS_PER_US;
+    print("Open and close at depth ");
+    printI(DEPTH + 1);
+    print(": (us) ");
+    printI(us / OPENS);
+    print("\n");
+    print_dcache_stats();
+    print_bcache_stats();
+
+    strcpy(buf, bench_file);
+    remove(buf);
+    for (int i = DEPTH - 1; i >= 0; i--) {
+        strcpy(buf, bench_dirs[i]);
+        rmdir(buf);
+    }
+    exit(EXIT_SUCCESS);
+}
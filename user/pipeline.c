@@ -0,0 +1,61 @@
+#include "libc.h"
+
+// Size of the buffer handed from the producer to the consumer, and how many times it is passed
+#define BUFFER_WORDS (4096)
+#define ROUNDS (8)
+
+// Fill the shared buffer once per round, waiting for the consumer to hand it back in between
+// -- The buffer is too big for a message, so only the round number goes through the queues.
+void producer(int id, int empty, int full) {
+    uint32_t* buffer = shm_attach(id);
+    for (int r = 0; r < ROUNDS; r++) {
+        int round;
+        mq_receive(empty, &round, sizeof(round), NULL);
+        for (int i = 0; i < BUFFER_WORDS; i++) {
+            buffer[i] = r * BUFFER_WORDS + i;
+        }
+        mq_send(full, &r, sizeof(r), 0);
+    }
+    shm_detach(buffer);
+    exit(EXIT_SUCCESS);
+}
+
+// Main function, sets up the shared buffer then consumes every round the forked producer writes
+void main_pipeline() {
+    int id = shm_create(sizeof(uint32_t) * BUFFER_WORDS);
+    uint32_t* buffer = shm_attach(id);
+    if (buffer == NULL) {
+        print("Could not create shared memory\n");
+        exit(EXIT_FAILURE);
+    }
+    // The names are only needed to create the queues, they go once closed
+    int empty = mq_open("pipe-empty", 1, sizeof(int));
+    int full = mq_open("pipe-full", 1, sizeof(int));
+    mq_unlink("pipe-empty");
+    mq_unlink("pipe-full");
+
+    if (0 == fork()) {
+        producer(id, empty, full);
+    }
+
+    for (int r = 0; r < ROUNDS; r++) {
+        // Hand the buffer over, then wait for it to come back full
+        mq_send(empty, &r, sizeof(r), 0);
+        int round;
+        mq_receive(full, &round, sizeof(round), NULL);
+        uint32_t sum = 0;
+        for (int i = 0; i < BUFFER_WORDS; i++) {
+            sum += buffer[i];
+        }
+        print("Round ");
+        printI(round);
+        print(" sum ");
+        printI(sum);
+        print("\n");
+    }
+
+    shm_detach(buffer);
+    mq_close(empty);
+    mq_close(full);
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,13 @@
+#include "libc.h"
+
+// How many numbers to print
+#define COUNT (200)
+
+// Main function, prints the numbers 1 to COUNT one per line (e.g. to feed into a pipe)
+void main_seq() {
+    for (int i = 1; i <= COUNT; i++) {
+        printI(i);
+        print("\n");
+    }
+    exit(EXIT_SUCCESS);
+}
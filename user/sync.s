@@ -0,0 +1,247 @@
+.global mutex_lock
+.global mutex_unlock
+.global semaphore_trywait
+.global semaphore_post
+.global atomic_swap
+.global atomic_add
+.global atomic_cas
+.global atomic_fetch_add
+.global atomic_cas64
+.global atomic_load64
+.global memory_barrier
+.global barrier_arrive
+.global rwlock_read_lock
+.global rwlock_read_unlock
+.global rwlock_write_lock
+.global rwlock_write_unlock
+
+@ Mutex states: 0 unlocked, 1 locked, 2 locked with (possible) waiters
+
+mutex_lock:
+    ldrex r1, [r0]
+    cmp r1, #0
+    bne mutex_lock_held
+    mov r1, #1
+    strex r2, r1, [r0]
+    cmp r2, #0
+    bne mutex_lock
+    dmb
+    mov pc, lr
+mutex_lock_held:
+    clrex
+    b mutex_lock_slow
+
+mutex_unlock:
+    dmb
+mutex_unlock_retry:
+    ldrex r1, [r0]
+    sub r2, r1, #1
+    strex r3, r2, [r0]
+    cmp r3, #0
+    bne mutex_unlock_retry
+    cmp r1, #1
+    moveq pc, lr
+    b mutex_unlock_slow
+
+@ Semaphore layout: value at +0, number of waiters at +4
+
+semaphore_trywait:
+    ldrex r1, [r0]
+    cmp r1, #0
+    ble semaphore_trywait_fail
+    sub r1, r1, #1
+    strex r2, r1, [r0]
+    cmp r2, #0
+    bne semaphore_trywait
+    dmb
+    mov r0, #1
+    mov pc, lr
+semaphore_trywait_fail:
+    clrex
+    mov r0, #0
+    mov pc, lr
+
+semaphore_post:
+    dmb
+semaphore_post_retry:
+    ldrex r1, [r0]
+    add r1, r1, #1
+    strex r2, r1, [r0]
+    cmp r2, #0
+    bne semaphore_post_retry
+    dmb
+    ldr r1, [r0, #4]
+    cmp r1, #0
+    moveq pc, lr
+    b semaphore_post_slow
+
+atomic_swap:
+    ldrex r2, [r0]
+    strex r3, r1, [r0]
+    cmp r3, #0
+    bne atomic_swap
+    dmb
+    mov r0, r2
+    mov pc, lr
+
+atomic_add:
+    ldrex r2, [r0]
+    add r2, r2, r1
+    strex r3, r2, [r0]
+    cmp r3, #0
+    bne atomic_add
+    dmb
+    mov r0, r2
+    mov pc, lr
+
+atomic_cas:
+    ldrex r3, [r0]
+    cmp r3, r1
+    bne atomic_cas_fail
+    strex r12, r2, [r0]
+    cmp r12, #0
+    bne atomic_cas
+    dmb
+    mov r0, r3
+    mov pc, lr
+atomic_cas_fail:
+    clrex
+    mov r0, r3
+    mov pc, lr
+
+@ Unlike atomic_add this returns the old value, and orders memory on both sides of the update
+
+atomic_fetch_add:
+    dmb
+atomic_fetch_add_retry:
+    ldrex r2, [r0]
+    add r3, r2, r1
+    strex r12, r3, [r0]
+    cmp r12, #0
+    bne atomic_fetch_add_retry
+    dmb
+    mov r0, r2
+    mov pc, lr
+
+@ Doubleword compare-and-swap, the address must be 8 byte aligned
+@ The old value arrives in r2-r3 and the new one on the stack, returns 1 if the swap happened
+
+atomic_cas64:
+    push {r4-r7}
+    ldrd r4, r5, [sp, #16]
+    dmb
+atomic_cas64_retry:
+    ldrexd r6, r7, [r0]
+    cmp r6, r2
+    cmpeq r7, r3
+    bne atomic_cas64_fail
+    strexd r1, r4, r5, [r0]
+    cmp r1, #0
+    bne atomic_cas64_retry
+    dmb
+    mov r0, #1
+    pop {r4-r7}
+    mov pc, lr
+atomic_cas64_fail:
+    clrex
+    mov r0, #0
+    pop {r4-r7}
+    mov pc, lr
+
+@ A plain ldrd can tear on this core, an exclusive load reads both words at once
+
+atomic_load64:
+    ldrexd r2, r3, [r0]
+    clrex
+    mov r0, r2
+    mov r1, r3
+    mov pc, lr
+
+memory_barrier:
+    dmb
+    mov pc, lr
+
+@ Barrier layout: processes arrived at +0, generation at +4, number of parties at +8, number of sleepers at +12
+@ The last process to arrive resets the count, moves the barrier on a generation and gets 1 back
+
+barrier_arrive:
+    ldr r3, [r0, #8]
+barrier_arrive_retry:
+    ldrex r1, [r0]
+    add r1, r1, #1
+    cmp r1, r3
+    moveq r1, #0
+    strex r2, r1, [r0]
+    cmp r2, #0
+    bne barrier_arrive_retry
+    dmb
+    cmp r1, #0
+    movne r0, #0
+    movne pc, lr
+    ldr r1, [r0, #4]
+    add r1, r1, #1
+    str r1, [r0, #4]
+    dmb
+    mov r0, #1
+    mov pc, lr
+
+@ Reader-writer lock layout: state at +0, number of sleepers at +4
+@ The state counts readers in bits 0-15, bit 16 is set while a writer holds the lock and waiting writers are counted from bit 17
+
+rwlock_read_lock:
+    ldrex r1, [r0]
+    lsrs r2, r1, #16
+    bne rwlock_read_lock_held
+    add r1, r1, #1
+    strex r2, r1, [r0]
+    cmp r2, #0
+    bne rwlock_read_lock
+    dmb
+    mov pc, lr
+rwlock_read_lock_held:
+    clrex
+    b rwlock_read_lock_slow
+
+rwlock_read_unlock:
+    dmb
+rwlock_read_unlock_retry:
+    ldrex r1, [r0]
+    sub r1, r1, #1
+    strex r2, r1, [r0]
+    cmp r2, #0
+    bne rwlock_read_unlock_retry
+    dmb
+    lsls r2, r1, #16
+    movne pc, lr
+    ldr r1, [r0, #4]
+    cmp r1, #0
+    moveq pc, lr
+    b rwlock_wake
+
+rwlock_write_lock:
+    ldrex r1, [r0]
+    cmp r1, #0
+    bne rwlock_write_lock_held
+    mov r1, #0x10000
+    strex r2, r1, [r0]
+    cmp r2, #0
+    bne rwlock_write_lock
+    dmb
+    mov pc, lr
+rwlock_write_lock_held:
+    clrex
+    b rwlock_write_lock_slow
+
+rwlock_write_unlock:
+    dmb
+rwlock_write_unlock_retry:
+    ldrex r1, [r0]
+    sub r1, r1, #0x10000
+    strex r2, r1, [r0]
+    cmp r2, #0
+    bne rwlock_write_unlock_retry
+    dmb
+    ldr r1, [r0, #4]
+    cmp r1, #0
+    moveq pc, lr
+    b rwlock_wake
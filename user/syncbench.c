@@ -0,0 +1,83 @@
+#include "libc.h"
+
+// Largest number of workers tried, barrier rounds per run, and lock operations per reader
+#define MAX_WORKERS (8)
+#define ROUNDS (200)
+#define READS (2000)
+#define TABLE_WORDS (64)
+
+// Barriers and the shared table, globals are shared by every process
+barrier_t bench_start;
+barrier_t bench_round;
+rwlock_t bench_lock;
+uint32_t bench_table[TABLE_WORDS];
+
+// Worker for the barrier run, meets the others ROUNDS times
+void barrier_worker() {
+    barrier_wait(&bench_start);
+    for (int r = 0; r < ROUNDS; r++) {
+        barrier_wait(&bench_round);
+    }
+    barrier_wait(&bench_start);
+    exit(EXIT_SUCCESS);
+}
+
+// Worker for the reader run, sums the table under the read lock with the odd update from worker 0
+void reader_worker(int id) {
+    barrier_wait(&bench_start);
+    for (int i = 0; i < READS; i++) {
+        if (id == 0 && i % 100 == 0) {
+            rwlock_write_lock(&bench_lock);
+            for (int j = 0; j < TABLE_WORDS; j++) {
+                bench_table[j]++;
+            }
+            rwlock_write_unlock(&bench_lock);
+        } else {
+            rwlock_read_lock(&bench_lock);
+            volatile uint32_t sum = 0;
+            for (int j = 0; j < TABLE_WORDS; j++) {
+                sum += bench_table[j];
+            }
+            rwlock_read_unlock(&bench_lock);
+        }
+    }
+    barrier_wait(&bench_start);
+    exit(EXIT_SUCCESS);
+}
+
+// Time a run of n workers, the caller is the extra party that starts and stops the clock
+uint32_t bench_run(int n, bool readers) {
+    barrier_init(&bench_start, n + 1);
+    barrier_init(&bench_round, n);
+    rwlock_init(&bench_lock);
+    for (int i = 0; i < n; i++) {
+        if (fork() == 0) {
+            if (readers) {
+                reader_worker(i);
+            } else {
+                barrier_worker();
+            }
+        }
+    }
+    barrier_wait(&bench_start);
+    uint32_t begin = clock_ticks();
+    barrier_wait(&bench_start);
+    return (clock_ticks() - begin) / CLOCK_TICKS_PER_US;
+}
+
+// Main function, measures barrier round trips and reader throughput for 1, 2, 4 and 8 workers
+void main_syncbench() {
+    for (int n = 1; n <= MAX_WORKERS; n *= 2) {
+        uint32_t us = bench_run(n, false);
+        print("Workers ");
+        printI(n);
+        print(": barrier round trip (us) ");
+        printI(us / ROUNDS);
+
+        us = bench_run(n, true);
+        print(", reads per ms ");
+        printI(us == 0 ? 0 : (uint32_t) ((uint64_t) n * READS * 1000 / us));
+        print("\n");
+    }
+    exit(EXIT_SUCCESS);
+}
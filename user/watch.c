@@ -0,0 +1,63 @@
+#include "libc.h"
+
+// Number of messages each writer sends, and the gap between them
+#define MESSAGES (5)
+
+// Write a numbered line down a pipe every gap ms, then hang up
+void watch_writer(int fd, int id, int gap) {
+    for (int i = 0; i < MESSAGES; i++) {
+        poll(NULL, 0, gap);
+        char line[] = "writer 0 line 0\n";
+        line[7] = '0' + id;
+        line[14] = '0' + i;
+        write(fd, line, sizeof(line) - 1);
+    }
+    exit(EXIT_SUCCESS);
+}
+
+// Main function, watches two pipes fed at different rates and STDIN from one process until both pipes hang up
+void main_watch() {
+    pollfd_t fds[3];
+    for (int id = 0; id < 2; id++) {
+        int p[2];
+        if (pipe(p) == -1) {
+            print("Could not create pipe\n");
+            exit(EXIT_FAILURE);
+        }
+        if (fork() == 0) {
+            close(p[0]);
+            watch_writer(p[1], id, 100 + 150 * id);
+        }
+        close(p[1]);
+        fds[id] = (pollfd_t) {p[0], POLLIN, 0};
+    }
+    fds[2] = (pollfd_t) {STDIN_FILENO, POLLIN, 0};
+
+    int open = 2;
+    char buf[64];
+    while (open > 0) {
+        if (poll(fds, 3, 1000) == 0) {
+            print("Nothing for a second\n");
+            continue;
+        }
+        for (int i = 0; i < 3; i++) {
+            if (fds[i].revents & POLLIN) {
+                int n = read(fds[i].fd, buf, sizeof(buf) - 1);
+                buf[n] = '\0';
+                print(i == 2 ? "stdin: " : "pipe: ");
+                print(buf);
+                if (i == 2) {
+                    print("\n");
+                }
+            } else if (fds[i].revents & POLLHUP) {
+                // Stop watching a pipe once it has hung up and been drained
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                fds[i].events = 0;
+                open--;
+            }
+        }
+    }
+    print("Both writers have finished\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,24 @@
+#include "libc.h"
+
+// Main function, counts the lines and bytes on stdin until end-of-file and prints the totals
+void main_wc() {
+    char buf[64];
+    int lines = 0;
+    int bytes = 0;
+    int n;
+    while ((n = read(STDIN_FILENO, buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < n; i++) {
+            if (buf[i] == '\n') {
+                lines++;
+            }
+        }
+        bytes += n;
+    }
+
+    print("Lines ");
+    printI(lines);
+    print(" bytes ");
+    printI(bytes);
+    print("\n");
+    exit(EXIT_SUCCESS);
+}